@@ -0,0 +1,349 @@
+
+// Records whose layout is chosen at runtime
+// A container holds one Kokkos::Struct record type as either a struct of
+// arrays or an array of structs, and the code using it is split into named
+// phases that declare how they access the records. Each phase is compiled for
+// both layouts and its time is recorded in whichever one it ran. When a phase
+// starts a new run of calls, the container predicts its time in each layout,
+// from the measured times, or from the cache lines a call touches if it has
+// not run in a layout yet, and converts the records to the other layout if
+// the gain over the expected length of the run is more than a conversion
+// takes
+// The benchmark alternates between streaming through the positions and
+// velocities of every particle, which favours a struct of arrays, and
+// gathering whole particles at random indices, which favours an array of
+// structs
+
+#ifndef ADAPTIVE_LAYOUT_HPP
+#define ADAPTIVE_LAYOUT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "euler_particle.hpp"
+#include "particle_interaction.hpp"
+#include "record.hpp"
+
+namespace adaptive {
+
+enum layout { soa = 0, aos = 1 };
+
+inline const char* layout_name(const int l) {
+  return l == soa ? "SoA" : "AoS";
+}
+
+constexpr size_t cache_line = 64;
+
+// How a phase accesses the records
+enum class pattern {
+  // every record in order
+  stream,
+  // records at arbitrary indices
+  gather
+};
+
+struct access {
+  pattern kind;
+  // mask of the fields read or written
+  unsigned fields;
+  // records accessed per call
+  size_t count;
+};
+
+// Statistics of one phase
+struct phase {
+  access description;
+  // calls, and the runs of consecutive calls they came in
+  size_t calls = 0;
+  size_t runs = 0;
+  // time in ns and calls in each layout
+  uint64_t time[2] = {0, 0};
+  size_t timed[2] = {0, 0};
+
+  double mean(const int l) const {
+    return double(time[l])/timed[l];
+  }
+};
+
+template<class Struct>
+struct container {
+  typedef record_view<Struct, Kokkos::LayoutLeft> soa_type;
+  typedef record_view<Struct, Kokkos::LayoutRight> aos_type;
+  typedef records::traits<Struct> traits;
+
+  const std::string label;
+  const size_t n;
+  // whether to change layout, or keep the initial one
+  const bool adapt;
+  int current;
+
+  // only the current layout is allocated
+  soa_type soa_data;
+  aos_type aos_data;
+
+  std::map<std::string, phase> phases;
+  std::string last;
+
+  // time in ns of the last conversion, the cost a migration has to beat
+  double conversion = 0;
+  size_t migrations = 0;
+  uint64_t migration_time = 0;
+
+  container(const std::string& label, size_t n, const int initial, const bool adapt)
+    : label(label), n(n), adapt(adapt), current(initial),
+      soa_data(label, initial == soa ? n : 0), aos_data(label, initial == aos ? n : 0) {
+    if (adapt) {
+      // time a round trip, so the first decision has a conversion cost
+      migrate();
+      migrate();
+      migrations = 0;
+      migration_time = 0;
+    }
+  }
+
+  // Calls f with the records in the current layout
+  template<class F>
+  void apply(const F& f) const {
+    if (current == soa) {
+      f(soa_data);
+    } else {
+      f(aos_data);
+    }
+  }
+
+  // Runs one call of the named phase, after changing layout if that is
+  // predicted to pay off
+  template<class F>
+  void run(const std::string& name, const access& a, const F& f) {
+    phase& p = phases[name];
+    p.description = a;
+    if (name != last) {
+      if (adapt) {
+        decide(p);
+      }
+      p.runs++;
+      last = name;
+    }
+
+    Kokkos::fence();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    apply(f);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    p.time[current] += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    p.timed[current]++;
+    p.calls++;
+  }
+
+  // Bytes a call of a phase moves in layout l, counting whole cache lines for
+  // gathers
+  double model(const access& a, const int l) const {
+    // of the accessed fields, per record
+    size_t bytes = 0;
+    size_t fields = 0;
+    for (int field = 0; field < traits::fields; field++) {
+      if (a.fields & (1u << field)) {
+        bytes += traits::field_size(field);
+        fields++;
+      }
+    }
+    const size_t record = sizeof(typename aos_type::value_type);
+
+    if (a.kind == pattern::stream) {
+      // only the fields used in SoA, every whole record in AoS
+      return double(a.count)*(l == soa ? bytes : record);
+    }
+    // a line per field in SoA, the lines of the record in AoS
+    return double(a.count)*cache_line*(l == soa ? fields : (record + cache_line - 1)/cache_line);
+  }
+
+  // Predicted time in ns of a call of the phase in layout l: its mean there,
+  // or its mean in the other layout scaled by the model, or 0 if it never ran
+  double predict(const phase& p, const int l) const {
+    if (p.timed[l]) {
+      return p.mean(l);
+    }
+    const int other = 1 - l;
+    if (p.timed[other]) {
+      return p.mean(other)*model(p.description, l)/model(p.description, other);
+    }
+    return 0;
+  }
+
+  // Migrates if the phase starting a run is expected to save more than the
+  // conversion takes
+  void decide(const phase& p) {
+    const int other = 1 - current;
+    // calls per run so far, the expected length of this one
+    const double length = p.runs ? double(p.calls)/p.runs : 1;
+    const double gain = (predict(p, current) - predict(p, other))*length;
+    if (gain > conversion) {
+      migrate();
+    }
+  }
+
+  // Converts the records to the other layout
+  void migrate() {
+    Kokkos::fence();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (current == soa) {
+      aos_data = aos_type(label, n);
+      convert(soa_data, aos_data);
+      soa_data = soa_type(label, 0);
+    } else {
+      soa_data = soa_type(label, n);
+      convert(aos_data, soa_data);
+      aos_data = aos_type(label, 0);
+    }
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    current = 1 - current;
+    conversion = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    migration_time += conversion;
+    migrations++;
+  }
+
+  template<class From, class To>
+  void convert(const From& from, const To& to) const {
+    Kokkos::parallel_for("adaptive::convert", n, KOKKOS_LAMBDA(const size_t& i) {
+      records::for_each_field(typename traits::indices(), [&](auto field) {
+        to.template field<decltype(field)::value>(i) = from.template field<decltype(field)::value>(i);
+      });
+    });
+  }
+};
+
+// Layout of the benchmark's particles
+enum class policy { soa, aos, adapt };
+
+// Fields of euler_particle_struct
+constexpr size_t accel = 0;
+constexpr size_t vel = 3;
+constexpr size_t pos = 6;
+constexpr unsigned drift_fields = 0x3fu << vel;
+constexpr unsigned all_fields = (1u << records::traits<euler_particle_struct>::fields) - 1;
+
+// Fills every particle
+struct fill {
+  size_t n;
+
+  template<class Storage>
+  void operator()(const Storage& p) const {
+    Kokkos::parallel_for("adaptive::fill", n, KOKKOS_LAMBDA(const size_t& i) {
+      records::for_each_field(typename Storage::indices(), [&](auto field) {
+        p.template field<decltype(field)::value>(i) = interaction::uniform(i, decltype(field)::value);
+      });
+    });
+  }
+};
+
+// Moves every particle by its velocity, reading and writing only the
+// positions and velocities
+struct drift {
+  size_t n;
+
+  template<class Storage>
+  void operator()(const Storage& p) const {
+    Kokkos::parallel_for("adaptive::drift", n, KOKKOS_LAMBDA(const size_t& i) {
+      const double dt = 0.001;
+      p.template field<pos + 0>(i) += dt*p.template field<vel + 0>(i);
+      p.template field<pos + 1>(i) += dt*p.template field<vel + 1>(i);
+      p.template field<pos + 2>(i) += dt*p.template field<vel + 2>(i);
+    });
+  }
+};
+
+// Reads every field of the particles at the given indices
+struct gather {
+  Kokkos::View<uint32_t*> index;
+  Kokkos::View<double*> result;
+
+  template<class Storage>
+  void operator()(const Storage& p) const {
+    auto index = this->index;
+    auto result = this->result;
+    Kokkos::parallel_for("adaptive::gather", index.extent(0), KOKKOS_LAMBDA(const size_t& j) {
+      const size_t i = index(j);
+      double sum = 0;
+      records::for_each_field(typename Storage::indices(), [&](auto field) {
+        sum += p.template field<decltype(field)::value>(i);
+      });
+      result(j) = sum;
+    });
+  }
+};
+
+} // namespace adaptive
+
+// Alternating workload on Euler particle records: each trial drifts the
+// particles steps times, then gathers n particles at random indices
+// The particles are kept in SoA, in AoS, or adapt their layout
+struct adaptive_euler {
+  const size_t n;
+  const size_t steps;
+
+  adaptive::container<euler_particle_struct> particles;
+  Kokkos::View<uint32_t*> index;
+  Kokkos::View<double*> gathered;
+
+  std::vector<uint64_t> times;
+
+  adaptive_euler(size_t n, adaptive::policy policy, size_t steps)
+    : n(n), steps(steps),
+      particles("adaptive_euler::particles", n,
+                policy == adaptive::policy::aos ? adaptive::aos : adaptive::soa,
+                policy == adaptive::policy::adapt),
+      index("adaptive_euler::index", n), gathered("adaptive_euler::gathered", n) {
+    setup();
+  }
+
+  void setup() {
+    particles.apply(adaptive::fill{n});
+    auto index = this->index;
+    const size_t n = this->n;
+    Kokkos::parallel_for("adaptive_euler::setup", n, KOKKOS_LAMBDA(const size_t& j) {
+      index(j) = uint32_t(interaction::uniform(j, 13)*n);
+    });
+    Kokkos::fence();
+  }
+
+  void test() {
+    const adaptive::access drift = {adaptive::pattern::stream, adaptive::drift_fields, n};
+    const adaptive::access gather = {adaptive::pattern::gather, adaptive::all_fields, n};
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (size_t s = 0; s < steps; s++) {
+      particles.run("drift", drift, adaptive::drift{n});
+    }
+    particles.run("gather", gather, adaptive::gather{index, gathered});
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    std::cout << "    Layout: " << adaptive::layout_name(particles.current) << "; "
+              << "Migrations: " << double(particles.migrations)/times.size() << " per trial, "
+              << particles.migration_time/1e6 << " (ms) in total";
+    for (const auto& entry : particles.phases) {
+      const adaptive::phase& p = entry.second;
+      std::cout << "; " << entry.first << ":";
+      for (int l = adaptive::soa; l <= adaptive::aos; l++) {
+        if (p.timed[l]) {
+          std::cout << " " << adaptive::layout_name(l) << " " << p.mean(l)/1e6 << " (ms)";
+        }
+      }
+    }
+    std::cout << std::endl;
+  }
+};
+
+#endif // ADAPTIVE_LAYOUT_HPP
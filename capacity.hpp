@@ -1,64 +1,11 @@
 // Capacity test
 // Compare memory allocation size differences between SoA and AoS
+// The footprint itself is reported for every test by footprint.hpp
 
-#include <sys/time.h>
-#include <sys/resource.h>
-#include <sys/types.h>
-#include <sys/sysinfo.h>
-#include <iostream>
-#include <ios>
-#include <fstream>
-#include <string>
-#include <unistd.h>
-
-int parseLine(char* line) {
-  int i = strlen(line);
-  const char* p = line;
-  while(*p <'0' || *p > '9') p++;
-  line[i-3] = '\0';
-  i = atoi(p);
-  return i;
-}
-
-int getPhysMemKB() {
-  FILE* file = fopen("/proc/self/status", "r");
-  int result = -1;
-  char line[128];
-
-  while(fgets(line, 128, file) != NULL) {
-    if(strncmp(line, "VmRSS:", 6) == 0) {
-      result = parseLine(line);
-      break;
-    }
-  }
-  fclose(file);
-  return result;
-}
-
-void process_mem_usage(double& vm_usage, double& resident_set) {
-  vm_usage = 0.0;
-  resident_set = 0.0;
-
-  std::ifstream stat_stream("/proc/self/stat", std::ios_base::in);
-
-  std::string pid, comm, state, ppid, pgrp, session, tty_nr;
-  std::string tpgid, flags, minflt, cminflt, majflt, cmajflt;
-  std::string utime, stime, cutime, cstime, priority, nice;
-  std::string O, itrealvalue, starttime;
-
-  unsigned long vsize;
-  long rss;
-
-  stat_stream >> pid >> comm >> state >> ppid >> session >> tty_nr
-              >> tpgid >> flags >> minflt >> cminflt >> majflt >> cmajflt
-              >> utime >> stime >> cutime >> cstime >> priority >> nice
-              >> O >> itrealvalue >> starttime >> vsize >> rss;
-  stat_stream.close();
-  
-  long page_size_kb = sysconf(_SC_PAGE_SIZE) / 1024;
-  vm_usage = vsize/1024.0;
-  resident_set = rss*page_size_kb; 
-}
+#include <chrono>
+#include <cstdint>
+#include <Kokkos_Core.hpp>
+#include <vector>
 
 typedef struct {
   char a;
@@ -105,7 +52,7 @@ public:
   AoS(size_t n) : _data("AoS data", n) {}
   void fill() {
     Kokkos::parallel_for("Fill with 0s", _data.extent(0), KOKKOS_LAMBDA(const size_t i) {
-      auto entry = _data(i);
+      auto& entry = _data(i);
       entry.a = 0;
       entry.b = 0;
       entry.c = 0;
@@ -132,15 +79,12 @@ public:
   }
 
   void test() {
-//    struct rusage usage;
-//    getrusage(RUSAGE_SELF, &usage);
-//    int maxrss = usage.ru_maxrss;
-//
-//    double vm_usage, resident_set;
-//    process_mem_usage(vm_usage, resident_set);
-//    std::cout << typeid(Layout).name() << ": VM Usage: " << vm_usage << "KB\tRSS: " << resident_set << "KB\n";
-    int maxrss = getPhysMemKB();
-    std::cout << typeid(Layout).name() << ": RSS Usage: " << maxrss << "KB\n";
-//    times.push_back(maxrss);
+    // time fill kernel
+    auto t1 = std::chrono::high_resolution_clock::now();
+    _data.fill();
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
   }
 };
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Checks that the kernels expected to vectorize still do.
+
+Usage: check_vectorization.py EXPECTED[,EXPECTED...] RECORD...
+
+Each EXPECTED file lists one kernel per line: its label, then the function
+whose lambda is the kernel, as the compiler names it, e.g.
+
+    copy::test  copy<Kokkos::LayoutLeft, 8u>::test()
+
+RECORD are the optimisation records written by -fsave-optimization-record:
+GCC's .opt-record.json.gz or Clang's .opt.yaml. The text of -fopt-info-vec and
+-Rpass=loop-vectorize only gives the source line of each loop, which for a
+Kokkos kernel is the loop inside Kokkos shared by every kernel, whereas the
+records name the function the loop was compiled into. That is the kernel's
+own function when the loop was inlined into it, or a Kokkos function whose
+name contains the kernel's lambda, named after the function it is in.
+
+Prints whether each kernel was vectorized and exits with 1 if any was not.
+"""
+
+import gzip
+import json
+import os
+import re
+import subprocess
+import sys
+
+
+def gcc_vectorized(path):
+    """Mangled names of the functions with vectorized loops in a GCC record"""
+    functions = set()
+
+    def walk(node):
+        if isinstance(node, list):
+            for child in node:
+                walk(child)
+        elif isinstance(node, dict):
+            message = "".join(str(part) for part in node.get("message", []))
+            if node.get("kind") == "success" and message.startswith("loop vectorized"):
+                functions.add(node.get("function", ""))
+            walk(node.get("children", []))
+
+    with gzip.open(path, "rt") as record:
+        walk(json.load(record))
+    return functions
+
+
+def clang_vectorized(path):
+    """Mangled names of the functions with vectorized loops in a Clang record"""
+    functions = set()
+    with open(path) as record:
+        # one YAML document per remark; only the top level keys are needed
+        for remark in record.read().split("\n---"):
+            if not remark.lstrip("-").lstrip().startswith("!Passed"):
+                continue
+            keys = dict(re.findall(r"^(\w+):\s*'?([^'\n]*)'?$", remark, re.MULTILINE))
+            if keys.get("Pass") == "loop-vectorize":
+                functions.add(keys.get("Function", ""))
+    return functions
+
+
+def demangle(names):
+    names = sorted(names)
+    result = subprocess.run(["c++filt"], input="\n".join(names), capture_output=True, text=True, check=True)
+    return result.stdout.splitlines()
+
+
+def normalise(name):
+    # demanglers differ in where they put spaces, e.g. "> >" or ">>"
+    return re.sub(r"\s+", "", name)
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__.strip().splitlines()[2], file=sys.stderr)
+        return 2
+
+    mangled = set()
+    records = 0
+    for path in argv[2:]:
+        if not os.path.exists(path):
+            continue
+        records += 1
+        if path.endswith(".json.gz"):
+            mangled |= gcc_vectorized(path)
+        else:
+            mangled |= clang_vectorized(path)
+    if records == 0:
+        print("No optimisation records found", file=sys.stderr)
+        return 2
+    functions = [normalise(name) for name in demangle(mangled)]
+
+    failed = 0
+    for path in argv[1].split(","):
+        with open(path) as expected:
+            for line in expected:
+                line = line.split("#", 1)[0].strip()
+                if not line:
+                    continue
+                label, function = line.split(None, 1)
+                # the function itself, or a lambda in it, and not another
+                # class whose name ends the same way
+                pattern = re.compile(r"(^|[^\w:])" + re.escape(normalise(function)))
+                vectorized = any(pattern.search(name) for name in functions)
+                failed += not vectorized
+                print("%-14s %-22s %s" % ("vectorized" if vectorized else "NOT VECTORIZED", label, function))
+
+    if failed:
+        print("%d kernels expected to vectorize did not" % failed)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,478 @@
+
+// Binary checkpoint/restart of the Euler particle state
+// The file stores each particle field contiguously (struct of arrays), with
+// every field starting on a page boundary, so a LayoutLeft restart can mmap
+// the file and use it in place while a LayoutRight restart transposes it
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <Kokkos_Core.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "euler_particle.hpp"
+
+namespace checkpoint {
+
+constexpr char     magic[8]   = {'E', 'U', 'L', 'E', 'R', 'C', 'K', 'P'};
+constexpr uint32_t version    = 1;
+constexpr uint32_t max_fields = 32;
+constexpr uint64_t alignment  = 4096;
+
+enum field_type : uint32_t {
+  type_f64 = 1, type_f32,
+  type_i64, type_u64,
+  type_i32, type_u32,
+  type_i16, type_u16,
+  type_i8,  type_u8
+};
+
+template<class T> struct field_type_of {};
+template<> struct field_type_of<double>   { static constexpr uint32_t value = type_f64; };
+template<> struct field_type_of<float>    { static constexpr uint32_t value = type_f32; };
+template<> struct field_type_of<int64_t>  { static constexpr uint32_t value = type_i64; };
+template<> struct field_type_of<uint64_t> { static constexpr uint32_t value = type_u64; };
+template<> struct field_type_of<int32_t>  { static constexpr uint32_t value = type_i32; };
+template<> struct field_type_of<uint32_t> { static constexpr uint32_t value = type_u32; };
+template<> struct field_type_of<int16_t>  { static constexpr uint32_t value = type_i16; };
+template<> struct field_type_of<uint16_t> { static constexpr uint32_t value = type_u16; };
+template<> struct field_type_of<int8_t>   { static constexpr uint32_t value = type_i8; };
+template<> struct field_type_of<uint8_t>  { static constexpr uint32_t value = type_u8; };
+
+struct field_desc {
+  uint32_t type;
+  uint32_t size;
+  uint64_t offset;
+};
+
+// Fixed size header at the start of the file
+struct header {
+  char       magic[8];
+  uint32_t   version;
+  uint32_t   field_count;
+  uint64_t   n;
+  uint64_t   file_size;
+  field_desc fields[max_fields];
+};
+
+constexpr uint64_t align_up(uint64_t bytes) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// Describes the file contents for the fields of a Kokkos::Struct
+template<class Struct>
+struct schema {
+};
+
+template<class... Ts>
+struct schema<Kokkos::Struct<Ts...>> {
+  static_assert(sizeof...(Ts) <= max_fields, "too many fields for a checkpoint");
+
+  static constexpr uint32_t field_count = sizeof...(Ts);
+
+  // bytes of particle data, excluding the header and padding
+  static constexpr uint64_t payload(uint64_t n) {
+    return n * sum(sizeof(Ts)...);
+  }
+
+  static header make_header(uint64_t n) {
+    const uint32_t types[] = {field_type_of<Ts>::value...};
+    const uint32_t sizes[] = {uint32_t(sizeof(Ts))...};
+
+    header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.field_count = field_count;
+    h.n = n;
+
+    uint64_t offset = align_up(sizeof(header));
+    for (uint32_t i = 0; i < field_count; i++) {
+      h.fields[i].type = types[i];
+      h.fields[i].size = sizes[i];
+      h.fields[i].offset = offset;
+      offset += align_up(sizes[i]*n);
+    }
+    h.file_size = offset;
+    return h;
+  }
+
+  // throws if the header doesn't describe n particles of this schema, or the
+  // file of the given length is too short to hold them
+  static void check_header(const header& h, uint64_t n, uint64_t length) {
+    const header expected = make_header(n);
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) {
+      throw std::runtime_error("checkpoint: not a checkpoint file");
+    }
+    if (h.version != version) {
+      throw std::runtime_error("checkpoint: unsupported version");
+    }
+    if (h.n != n) {
+      throw std::runtime_error("checkpoint: particle count mismatch");
+    }
+    if (h.field_count != expected.field_count
+        || std::memcmp(h.fields, expected.fields, sizeof(h.fields)) != 0) {
+      throw std::runtime_error("checkpoint: field types don't match the particle type");
+    }
+    if (h.file_size != expected.file_size || length < h.file_size) {
+      throw std::runtime_error("checkpoint: file too short");
+    }
+  }
+
+private:
+  static constexpr uint64_t sum() { return 0; }
+  template<class... Sizes>
+  static constexpr uint64_t sum(uint64_t first, Sizes... rest) {
+    return first + sum(rest...);
+  }
+};
+
+// RAII wrapper around a memory mapped checkpoint file
+class mapped_file {
+public:
+  // maps an existing file for reading, populating the page tables up front
+  // Pages are private, so writes by the simulation don't reach the file
+  static std::shared_ptr<mapped_file> open_read(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("checkpoint: unable to open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("checkpoint: unable to stat " + path);
+    }
+    return std::shared_ptr<mapped_file>(
+      new mapped_file(fd, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE));
+  }
+
+  // creates a file of the given size and maps it for writing
+  // An existing file of that size is reused as it is, so rewriting it doesn't
+  // free and allocate its blocks again
+  static std::shared_ptr<mapped_file> create(const std::string& path, size_t length) {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("checkpoint: unable to create " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("checkpoint: unable to stat " + path);
+    }
+    if (size_t(st.st_size) != length && ftruncate(fd, length) != 0) {
+      ::close(fd);
+      throw std::runtime_error("checkpoint: unable to resize " + path);
+    }
+    return std::shared_ptr<mapped_file>(
+      new mapped_file(fd, length, PROT_READ | PROT_WRITE, MAP_SHARED));
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    munmap(_addr, _length);
+  }
+
+  // flushes a shared mapping back to the file
+  void sync() {
+    if (msync(_addr, _length, MS_SYNC) != 0) {
+      throw std::runtime_error("checkpoint: msync failed");
+    }
+  }
+
+  size_t length() const { return _length; }
+
+  header& head() const {
+    if (_length < sizeof(header)) {
+      throw std::runtime_error("checkpoint: file too short");
+    }
+    return *static_cast<header*>(_addr);
+  }
+
+  template<class T>
+  T* field(uint32_t i) const {
+    return reinterpret_cast<T*>(static_cast<char*>(_addr) + head().fields[i].offset);
+  }
+
+private:
+  mapped_file(int fd, size_t length, int prot, int flags) : _length(length) {
+    _addr = mmap(nullptr, length, prot, flags, fd, 0);
+    ::close(fd);
+    if (_addr == MAP_FAILED) {
+      throw std::runtime_error("checkpoint: mmap failed");
+    }
+  }
+
+  void* _addr;
+  size_t _length;
+};
+
+template<class T>
+using host_field = Kokkos::View<T*, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+
+typedef schema<euler_particle_struct> euler_schema;
+
+typedef std::integral_constant<bool,
+          Kokkos::SpaceAccessibility<Kokkos::HostSpace,
+                                     Kokkos::DefaultExecutionSpace::memory_space>::accessible>
+        host_accessible;
+
+// copies one SoA field into its place in the file
+template<class View>
+void write_field(const mapped_file& file, uint32_t i, const View& field) {
+  typedef typename View::non_const_value_type T;
+  Kokkos::deep_copy(host_field<T>(file.field<T>(i), field.extent(0)), field);
+}
+
+// uses the mapped field in place when the simulation can access host memory
+template<class View>
+void restart_field(View& field, const mapped_file& file, uint32_t i, std::true_type) {
+  typedef typename View::non_const_value_type T;
+  field = View(file.field<T>(i), field.extent(0));
+}
+
+template<class View>
+void restart_field(View& field, const mapped_file& file, uint32_t i, std::false_type) {
+  typedef typename View::non_const_value_type T;
+  Kokkos::deep_copy(field, host_field<T>(file.field<T>(i), field.extent(0)));
+}
+
+inline void write(const euler_particles<Kokkos::LayoutLeft>& p, const std::string& path) {
+  const header h = euler_schema::make_header(p.n);
+  auto file = mapped_file::create(path, h.file_size);
+  file->head() = h;
+
+  write_field(*file,  0, p.x_accel);
+  write_field(*file,  1, p.y_accel);
+  write_field(*file,  2, p.z_accel);
+  write_field(*file,  3, p.x_vel);
+  write_field(*file,  4, p.y_vel);
+  write_field(*file,  5, p.z_vel);
+  write_field(*file,  6, p.x);
+  write_field(*file,  7, p.y);
+  write_field(*file,  8, p.z);
+  write_field(*file,  9, p.lifetime);
+  write_field(*file, 10, p.x_resistance);
+  write_field(*file, 11, p.y_resistance);
+  write_field(*file, 12, p.z_resistance);
+  Kokkos::fence();
+
+  file->sync();
+}
+
+inline void write(const euler_particles<Kokkos::LayoutRight>& p, const std::string& path) {
+  const header h = euler_schema::make_header(p.n);
+  auto file = mapped_file::create(path, h.file_size);
+  file->head() = h;
+
+  auto particles = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), p.particles);
+
+  double*   x_accel      = file->field<double>(0);
+  double*   y_accel      = file->field<double>(1);
+  double*   z_accel      = file->field<double>(2);
+  double*   x_vel        = file->field<double>(3);
+  double*   y_vel        = file->field<double>(4);
+  double*   z_vel        = file->field<double>(5);
+  double*   x            = file->field<double>(6);
+  double*   y            = file->field<double>(7);
+  double*   z            = file->field<double>(8);
+  uint32_t* lifetime     = file->field<uint32_t>(9);
+  uint8_t*  x_resistance = file->field<uint8_t>(10);
+  uint8_t*  y_resistance = file->field<uint8_t>(11);
+  uint8_t*  z_resistance = file->field<uint8_t>(12);
+
+  // transpose into the file
+  Kokkos::parallel_for("checkpoint::write_transpose",
+    Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, p.n),
+    [=](const size_t& i) {
+    x_accel[i]      = particles(i).x_accel;
+    y_accel[i]      = particles(i).y_accel;
+    z_accel[i]      = particles(i).z_accel;
+    x_vel[i]        = particles(i).x_vel;
+    y_vel[i]        = particles(i).y_vel;
+    z_vel[i]        = particles(i).z_vel;
+    x[i]            = particles(i).x;
+    y[i]            = particles(i).y;
+    z[i]            = particles(i).z;
+    lifetime[i]     = particles(i).lifetime;
+    x_resistance[i] = particles(i).x_resistance;
+    y_resistance[i] = particles(i).y_resistance;
+    z_resistance[i] = particles(i).z_resistance;
+  });
+  Kokkos::fence();
+
+  file->sync();
+}
+
+// Restarts p from the file without copying
+// The returned mapping backs p's Views and must outlive them
+inline std::shared_ptr<mapped_file> restart(euler_particles<Kokkos::LayoutLeft>& p, const std::string& path) {
+  auto file = mapped_file::open_read(path);
+  euler_schema::check_header(file->head(), p.n, file->length());
+
+  restart_field(p.x_accel,       *file,  0, host_accessible());
+  restart_field(p.y_accel,       *file,  1, host_accessible());
+  restart_field(p.z_accel,       *file,  2, host_accessible());
+  restart_field(p.x_vel,         *file,  3, host_accessible());
+  restart_field(p.y_vel,         *file,  4, host_accessible());
+  restart_field(p.z_vel,         *file,  5, host_accessible());
+  restart_field(p.x,             *file,  6, host_accessible());
+  restart_field(p.y,             *file,  7, host_accessible());
+  restart_field(p.z,             *file,  8, host_accessible());
+  restart_field(p.lifetime,      *file,  9, host_accessible());
+  restart_field(p.x_resistance,  *file, 10, host_accessible());
+  restart_field(p.y_resistance,  *file, 11, host_accessible());
+  restart_field(p.z_resistance,  *file, 12, host_accessible());
+  Kokkos::fence();
+
+  return file;
+}
+
+// Restarts p from the file by transposing into its existing storage
+inline std::shared_ptr<mapped_file> restart(euler_particles<Kokkos::LayoutRight>& p, const std::string& path) {
+  auto file = mapped_file::open_read(path);
+  euler_schema::check_header(file->head(), p.n, file->length());
+
+  auto particles = Kokkos::create_mirror_view(p.particles);
+
+  const double*   x_accel      = file->field<double>(0);
+  const double*   y_accel      = file->field<double>(1);
+  const double*   z_accel      = file->field<double>(2);
+  const double*   x_vel        = file->field<double>(3);
+  const double*   y_vel        = file->field<double>(4);
+  const double*   z_vel        = file->field<double>(5);
+  const double*   x            = file->field<double>(6);
+  const double*   y            = file->field<double>(7);
+  const double*   z            = file->field<double>(8);
+  const uint32_t* lifetime     = file->field<uint32_t>(9);
+  const uint8_t*  x_resistance = file->field<uint8_t>(10);
+  const uint8_t*  y_resistance = file->field<uint8_t>(11);
+  const uint8_t*  z_resistance = file->field<uint8_t>(12);
+
+  Kokkos::parallel_for("checkpoint::restart_transpose",
+    Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, p.n),
+    [=](const size_t& i) {
+    particles(i).x_accel      = x_accel[i];
+    particles(i).y_accel      = y_accel[i];
+    particles(i).z_accel      = z_accel[i];
+    particles(i).x_vel        = x_vel[i];
+    particles(i).y_vel        = y_vel[i];
+    particles(i).z_vel        = z_vel[i];
+    particles(i).x            = x[i];
+    particles(i).y            = y[i];
+    particles(i).z            = z[i];
+    particles(i).lifetime     = lifetime[i];
+    particles(i).x_resistance = x_resistance[i];
+    particles(i).y_resistance = y_resistance[i];
+    particles(i).z_resistance = z_resistance[i];
+  });
+  Kokkos::deep_copy(p.particles, particles);
+  Kokkos::fence();
+
+  return nullptr;
+}
+
+inline std::string path(const char* layout) {
+  return std::string("euler_particles_") + layout + ".ckpt";
+}
+
+} // namespace checkpoint
+
+template<class Layout>
+struct layout_name {
+};
+
+template<>
+struct layout_name<Kokkos::LayoutLeft> {
+  static constexpr const char* value = "left";
+};
+
+template<>
+struct layout_name<Kokkos::LayoutRight> {
+  static constexpr const char* value = "right";
+};
+
+// Times writing a checkpoint of the particle state
+template<class Layout>
+struct checkpoint_write {
+  const size_t n;
+  const size_t bytes;
+  const std::string path;
+
+  euler_particles<Layout> state;
+
+  std::vector<uint64_t> times;
+
+  checkpoint_write(size_t n)
+    : n(n), bytes(checkpoint::euler_schema::payload(n)),
+      path(checkpoint::path(layout_name<Layout>::value)), state(n) {
+    setup();
+  }
+
+  ~checkpoint_write() {
+    unlink(path.c_str());
+  }
+
+  // write once so the first trial doesn't pay for allocating the file's blocks
+  void setup() {
+    checkpoint::write(state, path);
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    checkpoint::write(state, path);
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+};
+
+// Times restarting the particle state from a checkpoint
+template<class Layout>
+struct checkpoint_restart {
+  const size_t n;
+  const size_t bytes;
+  const std::string path;
+
+  euler_particles<Layout> state;
+  std::shared_ptr<checkpoint::mapped_file> mapping;
+
+  std::vector<uint64_t> times;
+
+  checkpoint_restart(size_t n)
+    : n(n), bytes(checkpoint::euler_schema::payload(n)),
+      path(checkpoint::path(layout_name<Layout>::value)), state(n) {
+    setup();
+  }
+
+  ~checkpoint_restart() {
+    unlink(path.c_str());
+  }
+
+  void setup() {
+    checkpoint::write(state, path);
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    mapping = checkpoint::restart(state, path);
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+};
+
+#endif // CHECKPOINT_HPP
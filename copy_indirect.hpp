@@ -0,0 +1,145 @@
+
+// Indirect copy tests
+// Runs the copy kernels through an index View, either gathering
+// (dst(i) = src(idx(i))) or scattering (dst(idx(i)) = src(i))
+// The indices are always a permutation, so scatters never collide
+
+#ifndef COPY_INDIRECT_HPP
+#define COPY_INDIRECT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <Kokkos_Core.hpp>
+#include <numeric>
+#include <random>
+#include <vector>
+
+enum class index_pattern {
+  identity,       // i
+  block_shuffled, // blocks of consecutive entries, in a random block order
+  strided,        // i*stride mod n, for a stride coprime to n
+  random          // a uniformly random permutation
+};
+
+inline const char* index_pattern_name(const index_pattern pattern) {
+  switch (pattern) {
+    case index_pattern::identity:       return "identity";
+    case index_pattern::block_shuffled: return "block shuffled";
+    case index_pattern::strided:        return "strided";
+    case index_pattern::random:         return "random";
+  }
+  return "";
+}
+
+inline size_t gcd(size_t a, size_t b) {
+  while (b != 0) {
+    const size_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Builds a permutation of 0..n-1 following the given pattern
+inline Kokkos::View<uint32_t*> make_indices(const size_t n, const index_pattern pattern) {
+  // entries per block of the block shuffled pattern, and smallest stride tried
+  constexpr size_t block_size = 1024;
+  constexpr size_t min_stride = 33;
+
+  Kokkos::View<uint32_t*> indices("copy_indirect::indices", n);
+  auto host = Kokkos::create_mirror_view(indices);
+  std::mt19937_64 rng(560);
+
+  switch (pattern) {
+    case index_pattern::identity:
+      for (size_t i = 0; i < n; i++) {
+        host(i) = i;
+      }
+      break;
+
+    case index_pattern::block_shuffled: {
+      std::vector<size_t> blocks((n + block_size - 1)/block_size);
+      std::iota(blocks.begin(), blocks.end(), 0);
+      std::shuffle(blocks.begin(), blocks.end(), rng);
+      size_t i = 0;
+      for (size_t block : blocks) {
+        for (size_t j = block*block_size; j < std::min(n, (block + 1)*block_size); j++) {
+          host(i++) = j;
+        }
+      }
+      break;
+    }
+
+    case index_pattern::strided: {
+      size_t stride = min_stride;
+      while (n > 1 && gcd(stride, n) != 1) {
+        stride++;
+      }
+      for (size_t i = 0; i < n; i++) {
+        host(i) = (i*stride) % n;
+      }
+      break;
+    }
+
+    case index_pattern::random: {
+      std::vector<uint32_t> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      std::shuffle(order.begin(), order.end(), rng);
+      for (size_t i = 0; i < n; i++) {
+        host(i) = order[i];
+      }
+      break;
+    }
+  }
+
+  Kokkos::deep_copy(indices, host);
+  return indices;
+}
+
+// Gather or scatter version of one of the copy tests
+// Copy must provide copy_entry(to, from) and reset()
+template<class Copy, bool Scatter>
+struct copy_indirect {
+  const size_t n;
+
+  Copy base;
+  Kokkos::View<uint32_t*> indices;
+
+  std::vector<uint64_t> times;
+
+  copy_indirect(size_t n, index_pattern pattern)
+    : n(n), base(n), indices(make_indices(n, pattern)) {
+  }
+
+  void test() {
+    auto indices = this->indices;
+
+    // time copy kernel
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (Scatter) {
+      Kokkos::parallel_for("copy_indirect::scatter", n, KOKKOS_LAMBDA(const size_t& i) {
+        base.copy_entry(indices(i), i);
+      });
+    } else {
+      Kokkos::parallel_for("copy_indirect::gather", n, KOKKOS_LAMBDA(const size_t& i) {
+        base.copy_entry(i, indices(i));
+      });
+    }
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // reset for next iteration
+    base.reset();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+};
+
+template<class Copy>
+using copy_gather = copy_indirect<Copy, false>;
+
+template<class Copy>
+using copy_scatter = copy_indirect<Copy, true>;
+
+#endif // COPY_INDIRECT_HPP
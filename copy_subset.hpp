@@ -0,0 +1,61 @@
+
+// Field subset copy tests
+// Copies only the fields selected by a compile time mask, so the cost of
+// reading and writing a few fields of a wide record can be compared across
+// layouts
+
+#ifndef COPY_SUBSET_HPP
+#define COPY_SUBSET_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <Kokkos_Core.hpp>
+#include <vector>
+
+// Bytes of one entry in the fields selected by mask
+template<class Copy>
+constexpr size_t masked_bytes(const unsigned mask, const int field = 0) {
+  return field == Copy::fields ? 0
+       : ((mask >> field) & 1u ? Copy::field_size(field) : 0) + masked_bytes<Copy>(mask, field + 1);
+}
+
+// Mask selecting the first count fields
+constexpr unsigned first_fields(const int count) {
+  return (1u << count) - 1;
+}
+
+// Copy test touching only the fields in Mask
+// Copy must provide copy_entry<Mask>(to, from), reset(), fields and field_size
+template<class Copy, unsigned Mask>
+struct copy_subset {
+  static_assert(Mask != 0 && Mask <= first_fields(Copy::fields), "Mask must select existing fields");
+
+  const size_t n;
+  // read from src and written to dst, and no arithmetic
+  const size_t bytes;
+  static constexpr size_t flops = 0;
+
+  Copy base;
+
+  std::vector<uint64_t> times;
+
+  copy_subset(size_t n) : n(n), bytes(2*n*masked_bytes<Copy>(Mask)), base(n) {
+  }
+
+  void test() {
+    // time copy kernel
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_for("copy_subset::test", n, KOKKOS_LAMBDA(const size_t& i) {
+      base.template copy_entry<Mask>(i, i);
+    });
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // reset for next iteration
+    base.reset();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+};
+
+#endif // COPY_SUBSET_HPP
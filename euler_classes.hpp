@@ -0,0 +1,201 @@
+
+// Euler step without the drag branches
+// The resistance flags of a particle never change after setup, so the
+// particles are partitioned once by their resistance class, the 3 bit number
+// x + 2y + 4z of their flags, into 8 contiguous ranges. Each range is then
+// stepped by a kernel compiled for its flags, which applies drag, or not, with
+// no branch and without reading the flags
+// The partition is done at construction and not timed, as it would be once
+// when the particles are created. With the flags set by setup almost every
+// particle is in class 0, so the branches of the usual kernels are always
+// predicted and only the cost of the three flag streams is removed. The mixed
+// tests give every particle random flags instead, so the classes are about
+// equal and the branches of the usual kernels are unpredictable
+
+#ifndef EULER_CLASSES_HPP
+#define EULER_CLASSES_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <utility>
+#include <vector>
+
+#include "euler_particle.hpp"
+#include "particle_interaction.hpp"
+
+namespace euler_classes {
+
+constexpr size_t classes = 8;
+
+// Work of a live particle in a step, which no longer reads its flags
+constexpr size_t live_bytes = euler_live_bytes - 3*sizeof(uint8_t);
+
+template<class Access>
+KOKKOS_INLINE_FUNCTION uint32_t resistance_class(const Access& p, const size_t i) {
+  return (p.x_resistance(i) ? 1u : 0u) | (p.y_resistance(i) ? 2u : 0u) | (p.z_resistance(i) ? 4u : 0u);
+}
+
+// Advances particle i by one time step, as euler_integrate for a particle
+// with the given flags
+template<bool X, bool Y, bool Z, class Access>
+KOKKOS_INLINE_FUNCTION void integrate(const Access& p, const size_t i) {
+  const double dt = 0.001;
+  const double drag = 0.01;
+
+  if (p.lifetime(i) > 0) {
+    const double x_acceleration = X ? p.x_accel(i) - drag : p.x_accel(i);
+    const double y_acceleration = Y ? p.y_accel(i) - drag : p.y_accel(i);
+    const double z_acceleration = Z ? p.z_accel(i) - drag : p.z_accel(i);
+
+    p.x_vel(i) += dt*x_acceleration;
+    p.y_vel(i) += dt*y_acceleration;
+    p.z_vel(i) += dt*z_acceleration;
+
+    p.x(i) += dt*p.x_vel(i);
+    p.y(i) += dt*p.y_vel(i);
+    p.z(i) += dt*p.z_vel(i);
+
+    p.lifetime(i) -= 1;
+  }
+}
+
+// Sets each flag of each particle with probability 1/2
+template<class Particles>
+void mix_resistance(const Particles& particles) {
+  const euler_access<Particles> p(particles);
+  Kokkos::parallel_for("euler_classes::mix", particles.n, KOKKOS_LAMBDA(const size_t& i) {
+    p.x_resistance(i) = interaction::uniform(i, 10) < 0.5;
+    p.y_resistance(i) = interaction::uniform(i, 11) < 0.5;
+    p.z_resistance(i) = interaction::uniform(i, 12) < 0.5;
+  });
+  Kokkos::fence();
+}
+
+} // namespace euler_classes
+
+// The usual, branching, step of particles with mixed resistance classes
+template<class Particles>
+struct euler_mixed : Particles {
+  euler_mixed(size_t n) : Particles(n) {
+    euler_classes::mix_resistance<Particles>(*this);
+  }
+};
+
+// Steps particles of any layout partitioned by resistance class, with the
+// flags of setup or, if Mixed, mixed ones
+template<class Particles, bool Mixed = false>
+struct euler_classes_step {
+  const size_t n;
+
+  Particles particles;
+
+  // first particle of each class, plus n
+  size_t start[euler_classes::classes + 1];
+  uint64_t partition_time = 0;
+
+  // work of a step, from the particles alive at setup
+  size_t bytes = 0;
+  size_t flops = 0;
+
+  std::vector<uint64_t> times;
+
+  euler_classes_step(size_t n) : n(n), particles(n) {
+    partition();
+    count_work();
+  }
+
+  // Reorders the particles, as set up by Particles, so each class is contiguous
+  void partition() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Particles original(n);
+    if (Mixed) {
+      euler_classes::mix_resistance(original);
+    }
+    const euler_access<Particles> from(original);
+    const euler_access<Particles> to(particles);
+
+    Kokkos::View<uint32_t*> keys("euler_classes::keys", n);
+    Kokkos::View<uint32_t*> count("euler_classes::count", euler_classes::classes);
+    Kokkos::View<size_t*> offsets("euler_classes::start", euler_classes::classes + 1);
+    Kokkos::View<uint32_t*> order("euler_classes::order", n);
+    Kokkos::parallel_for("euler_classes::keys", n, KOKKOS_LAMBDA(const size_t& i) {
+      keys(i) = euler_classes::resistance_class(from, i);
+    });
+    interaction::counting_sort(keys, count, offsets, order);
+
+    Kokkos::parallel_for("euler_classes::permute", n, KOKKOS_LAMBDA(const size_t& i) {
+      const size_t j = order(i);
+      to.x_accel(i) = from.x_accel(j);
+      to.y_accel(i) = from.y_accel(j);
+      to.z_accel(i) = from.z_accel(j);
+      to.x_vel(i) = from.x_vel(j);
+      to.y_vel(i) = from.y_vel(j);
+      to.z_vel(i) = from.z_vel(j);
+      to.x(i) = from.x(j);
+      to.y(i) = from.y(j);
+      to.z(i) = from.z(j);
+      to.lifetime(i) = from.lifetime(j);
+      to.x_resistance(i) = from.x_resistance(j);
+      to.y_resistance(i) = from.y_resistance(j);
+      to.z_resistance(i) = from.z_resistance(j);
+    });
+
+    auto host = Kokkos::create_mirror_view(offsets);
+    Kokkos::deep_copy(host, offsets);
+    for (size_t c = 0; c <= euler_classes::classes; c++) {
+      start[c] = host(c);
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    partition_time = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+  }
+
+  void count_work() {
+    const euler_access<Particles> p(particles);
+    size_t live = 0;
+    Kokkos::parallel_reduce("euler_classes::live", n, KOKKOS_LAMBDA(const size_t& i, size_t& sum) {
+      sum += p.lifetime(i) > 0;
+    }, live);
+    bytes = live*euler_classes::live_bytes + (n - live)*euler_dead_bytes;
+    flops = live*euler_live_flops;
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    step(std::make_index_sequence<euler_classes::classes>());
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  // one kernel per non-empty class
+  template<size_t... C>
+  void step(std::index_sequence<C...>) {
+    const int expand[] = {(step_class<(C & 1) != 0, (C & 2) != 0, (C & 4) != 0>(start[C], start[C + 1]), 0)...};
+    (void) expand;
+  }
+
+  template<bool X, bool Y, bool Z>
+  void step_class(const size_t begin, const size_t end) {
+    if (begin == end) {
+      return;
+    }
+    const euler_access<Particles> p(particles);
+    Kokkos::parallel_for("euler_classes::step", Kokkos::RangePolicy<>(begin, end), KOKKOS_LAMBDA(const size_t& i) {
+      euler_classes::integrate<X, Y, Z>(p, i);
+    });
+  }
+
+  void report() const {
+    std::cout << "    Partition: " << partition_time/1e6 << " (ms); Classes:";
+    for (size_t c = 0; c < euler_classes::classes; c++) {
+      std::cout << " " << start[c + 1] - start[c];
+    }
+    std::cout << std::endl;
+  }
+};
+
+#endif // EULER_CLASSES_HPP
@@ -0,0 +1,137 @@
+
+// Euler particle emission
+// Each step integrates the particles, then emits up to a fixed number of new
+// particles into the slots of dead ones (lifetime 0)
+// The dead slots are found with a parallel_scan over the dead flags, which
+// writes the index of each into a compact free list, so slot management stays
+// parallel and gives the same slots in the same order every run
+
+#ifndef EULER_EMISSION_HPP
+#define EULER_EMISSION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <vector>
+
+#include "euler_particle.hpp"
+#include "particle_interaction.hpp"
+
+namespace emission {
+
+// lifetime in steps of emitted particles is 1 to max_lifetime
+constexpr uint32_t max_lifetime = 64;
+
+// Initialises slot i as the emitted particle with the given id
+// Particles leave the origin with a random velocity
+template<class Access>
+KOKKOS_INLINE_FUNCTION void emit(const Access& p, const size_t i, const uint64_t id) {
+  p.x_accel(i) = 0;
+  p.y_accel(i) = -9.81;
+  p.z_accel(i) = 0;
+
+  p.x_vel(i) = interaction::uniform(id, 0) - 0.5;
+  p.y_vel(i) = interaction::uniform(id, 1);
+  p.z_vel(i) = interaction::uniform(id, 2) - 0.5;
+
+  p.x(i) = 0;
+  p.y(i) = 0;
+  p.z(i) = 0;
+
+  p.lifetime(i) = 1 + uint32_t(interaction::uniform(id, 3)*max_lifetime);
+
+  p.x_resistance(i) = interaction::uniform(id, 4) < 0.1;
+  p.y_resistance(i) = interaction::uniform(id, 5) < 0.1;
+  p.z_resistance(i) = interaction::uniform(id, 6) < 0.1;
+}
+
+} // namespace emission
+
+// Euler step then emission of up to emit particles into dead slots
+// Particles is any of the Euler particle sets
+// Every slot starts as an emitted particle and the population is run for
+// max_lifetime steps before timing, so the tests see the steady state where
+// as many particles die each step as are emitted
+template<class Particles>
+struct euler_emission {
+  const size_t n;
+  const size_t emit;
+
+  Particles state;
+  Kokkos::View<uint32_t*> free;
+  // id of the next emitted particle
+  uint64_t next_id = 0;
+
+  std::vector<uint64_t> times;
+  uint64_t step_time = 0;
+  uint64_t emit_time = 0;
+  uint64_t emitted = 0;
+
+  euler_emission(size_t n, size_t emit)
+    : n(n), emit(emit), state(n), free("euler_emission::free", n) {
+    setup();
+  }
+
+  void setup() {
+    const euler_access<Particles> p(state);
+    Kokkos::parallel_for("euler_emission::setup", n, KOKKOS_LAMBDA(const size_t& i) {
+      emission::emit(p, i, i);
+    });
+    next_id = n;
+
+    for (uint32_t i = 0; i < emission::max_lifetime; i++) {
+      state.step(n);
+      recycle();
+    }
+    Kokkos::fence();
+  }
+
+  // emits into the first free slots, returning the number emitted
+  size_t recycle() {
+    const euler_access<Particles> p(state);
+    auto free = this->free;
+
+    // compact the indices of dead particles into the free list
+    uint32_t dead = 0;
+    Kokkos::parallel_scan("euler_emission::free", n, KOKKOS_LAMBDA(const size_t& i, uint32_t& offset, const bool final) {
+      const bool is_dead = p.lifetime(i) == 0;
+      if (final && is_dead) {
+        free(offset) = i;
+      }
+      offset += is_dead;
+    }, dead);
+
+    const size_t count = std::min(emit, size_t(dead));
+    const uint64_t first = next_id;
+    Kokkos::parallel_for("euler_emission::emit", count, KOKKOS_LAMBDA(const size_t& j) {
+      emission::emit(p, free(j), first + j);
+    });
+    next_id += count;
+    return count;
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    state.step(n);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const size_t count = recycle();
+    Kokkos::fence();
+    auto t3 = std::chrono::high_resolution_clock::now();
+
+    emitted += count;
+    step_time += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    emit_time += std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count();
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t1).count());
+  }
+
+  void report() const {
+    std::cout << "    Emitted: " << double(emitted)/times.size() << " of " << emit << " per step; "
+              << "Emission: " << emitted/(emit_time*1e-9) << " (particles/s); "
+              << "Step: " << step_time/1e6/times.size() << " (ms)" << std::endl;
+  }
+};
+
+#endif // EULER_EMISSION_HPP
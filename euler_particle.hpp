@@ -3,6 +3,9 @@
 // Each particle has an position, velocity, and acceleration
 // acceleration is constant, the other properties are updated
 // note that each particle is unaffected in any way by other particles
+// The Kokkos View particles take Kokkos::MemoryTraits flags for their Views,
+// e.g. Kokkos::Restrict so the step kernel of the struct of arrays can be
+// vectorized without checking whether the 13 arrays overlap
 
 #ifndef EULER_PARTICLE_HPP
 #define EULER_PARTICLE_HPP
@@ -12,13 +15,29 @@
 #include <Kokkos_Core.hpp>
 #include <vector>
 
+#include "record.hpp"
 
-template<class Layout>
+// Field list of a particle, in the same order as the members of particle_t
+typedef Kokkos::Struct<double, double, double,
+                       double, double, double,
+                       double, double, double,
+                       uint32_t, uint8_t, uint8_t, uint8_t>
+        euler_particle_struct;
+
+// Work of one particle in a step: a live particle reads every field, writes
+// its velocity, position and lifetime, and does 12 flops (ignoring drag,
+// which few particles have), while a dead one only reads its lifetime
+constexpr size_t euler_live_bytes = 9*sizeof(double) + sizeof(uint32_t) + 3*sizeof(uint8_t)
+                                  + 6*sizeof(double) + sizeof(uint32_t);
+constexpr size_t euler_dead_bytes = sizeof(uint32_t);
+constexpr size_t euler_live_flops = 12;
+
+template<class Layout, unsigned Traits = 0>
 struct euler_particles {
 };
 
-template<>
-struct euler_particles<Kokkos::LayoutRight> {
+template<unsigned Traits>
+struct euler_particles<Kokkos::LayoutRight, Traits> {
 
   const size_t n;
 
@@ -38,12 +57,26 @@ struct euler_particles<Kokkos::LayoutRight> {
     uint8_t z_resistance;
   };
 
-  Kokkos::View<particle_t*> particles;
+  records::view<Traits, particle_t*> particles;
+
+  // work of a step, from the particles alive at setup
+  size_t bytes = 0;
+  size_t flops = 0;
 
   std::vector<uint64_t> times;
 
   euler_particles(size_t n) : n(n), particles("euler_particles_sov::particles", n) {
     setup();
+    count_work();
+  }
+
+  void count_work() {
+    size_t live = 0;
+    Kokkos::parallel_reduce("euler_particles::live", n, KOKKOS_LAMBDA(const size_t& i, size_t& sum) {
+      sum += particles(i).lifetime > 0;
+    }, live);
+    bytes = live*euler_live_bytes + (n - live)*euler_dead_bytes;
+    flops = live*euler_live_flops;
   }
 
   void setup() {
@@ -76,7 +109,16 @@ struct euler_particles<Kokkos::LayoutRight> {
   void test() {
     // time copy kernel
     auto t1 = std::chrono::high_resolution_clock::now();
-    Kokkos::parallel_for("euler_particles_sov::test", n, KOKKOS_LAMBDA(const size_t& i) {
+    step(n);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  // advances the first count particles by one time step
+  void step(const size_t count) {
+    Kokkos::parallel_for("euler_particles_sov::test", count, KOKKOS_LAMBDA(const size_t& i) {
       const double dt = 0.001;
       const double drag = 0.01;
 
@@ -113,32 +155,32 @@ struct euler_particles<Kokkos::LayoutRight> {
         particles(i).lifetime -= 1;
       }
     });
-    Kokkos::fence();
-    auto t2 = std::chrono::high_resolution_clock::now();
-
-    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
   }
 };
 
 
-template<>
-struct euler_particles<Kokkos::LayoutLeft> {
+template<unsigned Traits>
+struct euler_particles<Kokkos::LayoutLeft, Traits> {
 
   const size_t n;
 
-  Kokkos::View<double*> x_accel;
-  Kokkos::View<double*> y_accel;
-  Kokkos::View<double*> z_accel;
-  Kokkos::View<double*> x_vel;
-  Kokkos::View<double*> y_vel;
-  Kokkos::View<double*> z_vel;
-  Kokkos::View<double*> x;
-  Kokkos::View<double*> y;
-  Kokkos::View<double*> z;
-  Kokkos::View<uint32_t*> lifetime;
-  Kokkos::View<uint8_t*> x_resistance;
-  Kokkos::View<uint8_t*> y_resistance;
-  Kokkos::View<uint8_t*> z_resistance;
+  records::view<Traits, double*> x_accel;
+  records::view<Traits, double*> y_accel;
+  records::view<Traits, double*> z_accel;
+  records::view<Traits, double*> x_vel;
+  records::view<Traits, double*> y_vel;
+  records::view<Traits, double*> z_vel;
+  records::view<Traits, double*> x;
+  records::view<Traits, double*> y;
+  records::view<Traits, double*> z;
+  records::view<Traits, uint32_t*> lifetime;
+  records::view<Traits, uint8_t*> x_resistance;
+  records::view<Traits, uint8_t*> y_resistance;
+  records::view<Traits, uint8_t*> z_resistance;
+
+  // work of a step, from the particles alive at setup
+  size_t bytes = 0;
+  size_t flops = 0;
 
   std::vector<uint64_t> times;
 
@@ -158,31 +200,48 @@ struct euler_particles<Kokkos::LayoutLeft> {
       y_resistance("euler_particles_sov::y_resistance", n),
       z_resistance("euler_particles_sov::z_resistance", n) {
     setup();
+    count_work();
+  }
+
+  void count_work() {
+    size_t live = 0;
+    Kokkos::parallel_reduce("euler_particles::live", n, KOKKOS_LAMBDA(const size_t& i, size_t& sum) {
+      sum += lifetime(i) > 0;
+    }, live);
+    bytes = live*euler_live_bytes + (n - live)*euler_dead_bytes;
+    flops = live*euler_live_flops;
   }
 
   void setup() {
+    setup(0, n);
+  }
+
+  // gives particle j the state setup gives particle first + j of total, so a
+  // set of total particles can be set up a part at a time
+  void setup(const size_t first, const size_t total) {
     Kokkos::parallel_for("euler_sov::setup", n,
-      KOKKOS_LAMBDA(const size_t& i) {
-      x_accel(i) = 5*i;
-      y_accel(i) = 2.4*i - 10000;
-      z_accel(i) = 0.87*(i*i);
+      KOKKOS_LAMBDA(const size_t& j) {
+      const size_t i = first + j;
+      x_accel(j) = 5*i;
+      y_accel(j) = 2.4*i - 10000;
+      z_accel(j) = 0.87*(i*i);
 
-      x_vel(i) = 1.0/i;
-      y_vel(i) = -2.0/i;
-      z_vel(i) = 1.0/(n-i);
+      x_vel(j) = 1.0/i;
+      y_vel(j) = -2.0/i;
+      z_vel(j) = 1.0/(total-i);
 
-      x(i) = -1.5/(i*i);
-      y(i) = 2.0/(n-i*i);
-      z(i) = 1.0/(i*i);
+      x(j) = -1.5/(i*i);
+      y(j) = 2.0/(total-i*i);
+      z(j) = 1.0/(i*i);
 
       // Create a mix of particle lifetimes such that
       // * some dead particles
       // * The number of tests run doesn't affect the amount of work done
-      lifetime(i) = ((i*31)%1024) * 100;
+      lifetime(j) = ((i*31)%1024) * 100;
 
-      x_resistance(i) = (i*71) < 10;
-      y_resistance(i) = (i*91) < 10;
-      z_resistance(i) = (i*81) < 10;
+      x_resistance(j) = (i*71) < 10;
+      y_resistance(j) = (i*91) < 10;
+      z_resistance(j) = (i*81) < 10;
     });
     Kokkos::fence();
   }
@@ -190,32 +249,26 @@ struct euler_particles<Kokkos::LayoutLeft> {
   void test() {
     // time copy kernel
     auto t1 = std::chrono::high_resolution_clock::now();
-    Kokkos::parallel_for("euler_sov::test", n, KOKKOS_LAMBDA(const size_t& i) {
-      const double dt = 0.001;
-      const double drag = 0.01;
-
-      if (lifetime(i) > 0) {
+    step(n);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
 
-        double x_acceleration, y_acceleration, z_acceleration;
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
 
-        if (x_resistance(i)) {
-          x_acceleration = x_accel(i) - drag;
-        } else {
-          x_acceleration = x_accel(i);
-        }
+  // advances the first count particles by one time step
+  // The accelerations are selected before the lifetime test, leaving it the
+  // only branch, so the compiler can vectorize the step with masked stores
+  void step(const size_t count) {
+    Kokkos::parallel_for("euler_sov::test", count, KOKKOS_LAMBDA(const size_t& i) {
+      const double dt = 0.001;
+      const double drag = 0.01;
 
-        if (y_resistance(i)) {
-          y_acceleration = y_accel(i) - drag;
-        } else {
-          y_acceleration = y_accel(i);
-        }
-
-        if (z_resistance(i)) {
-          z_acceleration = z_accel(i) - drag;
-        } else {
-          z_acceleration = z_accel(i);
-        }
+      const double x_acceleration = x_resistance(i) ? x_accel(i) - drag : x_accel(i);
+      const double y_acceleration = y_resistance(i) ? y_accel(i) - drag : y_accel(i);
+      const double z_acceleration = z_resistance(i) ? z_accel(i) - drag : z_accel(i);
 
+      if (lifetime(i) > 0) {
         x_vel(i) += dt*x_acceleration;
         y_vel(i) += dt*y_acceleration;
         z_vel(i) += dt*z_acceleration;
@@ -227,10 +280,6 @@ struct euler_particles<Kokkos::LayoutLeft> {
         lifetime(i) -= 1;
       }
     });
-    Kokkos::fence();
-    auto t2 = std::chrono::high_resolution_clock::now();
-
-    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
   }
 };
 
@@ -239,11 +288,7 @@ struct euler_particles_vos {
 
   const size_t n;
 
-  typedef Kokkos::Struct<double, double, double,
-                         double, double, double,
-                         double, double, double,
-                         uint32_t, uint8_t, uint8_t, uint8_t>
-          particle_t;
+  typedef euler_particle_struct particle_t;
 
   typedef Kokkos::Field<0>  x_accel;
   typedef Kokkos::Field<1>  y_accel;
@@ -263,10 +308,24 @@ struct euler_particles_vos {
 
   Kokkos::ViewOfStructs<particle_t*, Layout> particles;
 
+  // work of a step, from the particles alive at setup
+  size_t bytes = 0;
+  size_t flops = 0;
+
   std::vector<uint64_t> times;
 
   euler_particles_vos(size_t n) : n(n), particles("euler_particles_sov::particles", n) {
     setup();
+    count_work();
+  }
+
+  void count_work() {
+    size_t live = 0;
+    Kokkos::parallel_reduce("euler_particles::live", n, KOKKOS_LAMBDA(const size_t& i, size_t& sum) {
+      sum += particles(i, lifetime()) > 0;
+    }, live);
+    bytes = live*euler_live_bytes + (n - live)*euler_dead_bytes;
+    flops = live*euler_live_flops;
   }
 
   void setup() {
@@ -299,7 +358,16 @@ struct euler_particles_vos {
   void test() {
     // time copy kernel
     auto t1 = std::chrono::high_resolution_clock::now();
-    Kokkos::parallel_for("euler_particles_sov::test", n, KOKKOS_LAMBDA(const size_t& i) {
+    step(n);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  // advances the first count particles by one time step
+  void step(const size_t count) {
+    Kokkos::parallel_for("euler_particles_sov::test", count, KOKKOS_LAMBDA(const size_t& i) {
       const double dt = 0.001;
       const double drag = 0.01;
 
@@ -336,12 +404,129 @@ struct euler_particles_vos {
         particles(i, lifetime()) -= 1;
       }
     });
-    Kokkos::fence();
-    auto t2 = std::chrono::high_resolution_clock::now();
+  }
+};
 
-    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+
+// Uniform access to the fields of any of the particle layouts
+// Each accessor returns a reference to that field of particle i
+template<class Particles>
+struct euler_access {
+};
+
+template<unsigned Traits>
+struct euler_access<euler_particles<Kokkos::LayoutRight, Traits>> {
+  records::view<Traits, typename euler_particles<Kokkos::LayoutRight, Traits>::particle_t*> particles;
+
+  euler_access(const euler_particles<Kokkos::LayoutRight, Traits>& p) : particles(p.particles) {}
+
+  KOKKOS_INLINE_FUNCTION double& x_accel(const size_t i) const { return particles(i).x_accel; }
+  KOKKOS_INLINE_FUNCTION double& y_accel(const size_t i) const { return particles(i).y_accel; }
+  KOKKOS_INLINE_FUNCTION double& z_accel(const size_t i) const { return particles(i).z_accel; }
+  KOKKOS_INLINE_FUNCTION double& x_vel(const size_t i) const { return particles(i).x_vel; }
+  KOKKOS_INLINE_FUNCTION double& y_vel(const size_t i) const { return particles(i).y_vel; }
+  KOKKOS_INLINE_FUNCTION double& z_vel(const size_t i) const { return particles(i).z_vel; }
+  KOKKOS_INLINE_FUNCTION double& x(const size_t i) const { return particles(i).x; }
+  KOKKOS_INLINE_FUNCTION double& y(const size_t i) const { return particles(i).y; }
+  KOKKOS_INLINE_FUNCTION double& z(const size_t i) const { return particles(i).z; }
+  KOKKOS_INLINE_FUNCTION uint32_t& lifetime(const size_t i) const { return particles(i).lifetime; }
+  KOKKOS_INLINE_FUNCTION uint8_t& x_resistance(const size_t i) const { return particles(i).x_resistance; }
+  KOKKOS_INLINE_FUNCTION uint8_t& y_resistance(const size_t i) const { return particles(i).y_resistance; }
+  KOKKOS_INLINE_FUNCTION uint8_t& z_resistance(const size_t i) const { return particles(i).z_resistance; }
+};
+
+template<unsigned Traits>
+struct euler_access<euler_particles<Kokkos::LayoutLeft, Traits>> {
+  records::view<Traits, double*> _x_accel;
+  records::view<Traits, double*> _y_accel;
+  records::view<Traits, double*> _z_accel;
+  records::view<Traits, double*> _x_vel;
+  records::view<Traits, double*> _y_vel;
+  records::view<Traits, double*> _z_vel;
+  records::view<Traits, double*> _x;
+  records::view<Traits, double*> _y;
+  records::view<Traits, double*> _z;
+  records::view<Traits, uint32_t*> _lifetime;
+  records::view<Traits, uint8_t*> _x_resistance;
+  records::view<Traits, uint8_t*> _y_resistance;
+  records::view<Traits, uint8_t*> _z_resistance;
+
+  euler_access(const euler_particles<Kokkos::LayoutLeft, Traits>& p)
+    : _x_accel(p.x_accel),
+      _y_accel(p.y_accel),
+      _z_accel(p.z_accel),
+      _x_vel(p.x_vel),
+      _y_vel(p.y_vel),
+      _z_vel(p.z_vel),
+      _x(p.x),
+      _y(p.y),
+      _z(p.z),
+      _lifetime(p.lifetime),
+      _x_resistance(p.x_resistance),
+      _y_resistance(p.y_resistance),
+      _z_resistance(p.z_resistance) {
   }
+
+  KOKKOS_INLINE_FUNCTION double& x_accel(const size_t i) const { return _x_accel(i); }
+  KOKKOS_INLINE_FUNCTION double& y_accel(const size_t i) const { return _y_accel(i); }
+  KOKKOS_INLINE_FUNCTION double& z_accel(const size_t i) const { return _z_accel(i); }
+  KOKKOS_INLINE_FUNCTION double& x_vel(const size_t i) const { return _x_vel(i); }
+  KOKKOS_INLINE_FUNCTION double& y_vel(const size_t i) const { return _y_vel(i); }
+  KOKKOS_INLINE_FUNCTION double& z_vel(const size_t i) const { return _z_vel(i); }
+  KOKKOS_INLINE_FUNCTION double& x(const size_t i) const { return _x(i); }
+  KOKKOS_INLINE_FUNCTION double& y(const size_t i) const { return _y(i); }
+  KOKKOS_INLINE_FUNCTION double& z(const size_t i) const { return _z(i); }
+  KOKKOS_INLINE_FUNCTION uint32_t& lifetime(const size_t i) const { return _lifetime(i); }
+  KOKKOS_INLINE_FUNCTION uint8_t& x_resistance(const size_t i) const { return _x_resistance(i); }
+  KOKKOS_INLINE_FUNCTION uint8_t& y_resistance(const size_t i) const { return _y_resistance(i); }
+  KOKKOS_INLINE_FUNCTION uint8_t& z_resistance(const size_t i) const { return _z_resistance(i); }
 };
 
+template<class Layout>
+struct euler_access<euler_particles_vos<Layout>> {
+  typedef euler_particles_vos<Layout> particles_type;
+
+  Kokkos::ViewOfStructs<typename particles_type::particle_t*, Layout> particles;
+
+  euler_access(const particles_type& p) : particles(p.particles) {}
+
+  KOKKOS_INLINE_FUNCTION double& x_accel(const size_t i) const { return particles(i, typename particles_type::x_accel()); }
+  KOKKOS_INLINE_FUNCTION double& y_accel(const size_t i) const { return particles(i, typename particles_type::y_accel()); }
+  KOKKOS_INLINE_FUNCTION double& z_accel(const size_t i) const { return particles(i, typename particles_type::z_accel()); }
+  KOKKOS_INLINE_FUNCTION double& x_vel(const size_t i) const { return particles(i, typename particles_type::x_vel()); }
+  KOKKOS_INLINE_FUNCTION double& y_vel(const size_t i) const { return particles(i, typename particles_type::y_vel()); }
+  KOKKOS_INLINE_FUNCTION double& z_vel(const size_t i) const { return particles(i, typename particles_type::z_vel()); }
+  KOKKOS_INLINE_FUNCTION double& x(const size_t i) const { return particles(i, typename particles_type::x()); }
+  KOKKOS_INLINE_FUNCTION double& y(const size_t i) const { return particles(i, typename particles_type::y()); }
+  KOKKOS_INLINE_FUNCTION double& z(const size_t i) const { return particles(i, typename particles_type::z()); }
+  KOKKOS_INLINE_FUNCTION uint32_t& lifetime(const size_t i) const { return particles(i, typename particles_type::lifetime()); }
+  KOKKOS_INLINE_FUNCTION uint8_t& x_resistance(const size_t i) const { return particles(i, typename particles_type::x_resistance()); }
+  KOKKOS_INLINE_FUNCTION uint8_t& y_resistance(const size_t i) const { return particles(i, typename particles_type::y_resistance()); }
+  KOKKOS_INLINE_FUNCTION uint8_t& z_resistance(const size_t i) const { return particles(i, typename particles_type::z_resistance()); }
+};
+
+// Advances particle i by one time step, as in the step() kernels
+template<class Access>
+KOKKOS_INLINE_FUNCTION void euler_integrate(const Access& p, const size_t i) {
+  const double dt = 0.001;
+  const double drag = 0.01;
+
+  if (p.lifetime(i) > 0) {
+    const double x_acceleration = p.x_resistance(i) ? p.x_accel(i) - drag : p.x_accel(i);
+    const double y_acceleration = p.y_resistance(i) ? p.y_accel(i) - drag : p.y_accel(i);
+    const double z_acceleration = p.z_resistance(i) ? p.z_accel(i) - drag : p.z_accel(i);
+
+    p.x_vel(i) += dt*x_acceleration;
+    p.y_vel(i) += dt*y_acceleration;
+    p.z_vel(i) += dt*z_acceleration;
+
+    p.x(i) += dt*p.x_vel(i);
+    p.y(i) += dt*p.y_vel(i);
+    p.z(i) += dt*p.z_vel(i);
+
+    p.lifetime(i) -= 1;
+  }
+}
+
 
 #endif // EULER_PARTICLE_HPP
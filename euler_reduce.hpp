@@ -0,0 +1,234 @@
+
+// Reductions over the Euler particle state
+// The diagnostics computed each step: total kinetic energy, the axis aligned
+// bounding box of the particles with the number still alive, and a step that
+// integrates and computes both in the same pass
+// The Euler setup gives a few particles, such as particle 0, infinite
+// velocities or positions, so particles whose kinetic energy or position is
+// not finite are left out of the energy and the box (but not the live count)
+
+#ifndef EULER_REDUCE_HPP
+#define EULER_REDUCE_HPP
+
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <vector>
+
+#include "euler_particle.hpp"
+
+namespace euler_reduce {
+
+// false for infinities and NaN
+KOKKOS_INLINE_FUNCTION bool finite(const double v) {
+  return v >= -DBL_MAX && v <= DBL_MAX;
+}
+
+// Bounding box of the particle positions and number of live particles
+struct bounds {
+  double min[3];
+  double max[3];
+  uint64_t live;
+
+  KOKKOS_INLINE_FUNCTION void init() {
+    for (int d = 0; d < 3; d++) {
+      min[d] = DBL_MAX;
+      max[d] = -DBL_MAX;
+    }
+    live = 0;
+  }
+
+  KOKKOS_INLINE_FUNCTION void join(const bounds& other) {
+    for (int d = 0; d < 3; d++) {
+      min[d] = other.min[d] < min[d] ? other.min[d] : min[d];
+      max[d] = other.max[d] > max[d] ? other.max[d] : max[d];
+    }
+    live += other.live;
+  }
+
+  template<class Access>
+  KOKKOS_INLINE_FUNCTION void add(const Access& p, const size_t i) {
+    const double position[3] = {p.x(i), p.y(i), p.z(i)};
+    live += p.lifetime(i) > 0;
+    if (!finite(position[0]) || !finite(position[1]) || !finite(position[2])) {
+      return;
+    }
+    for (int d = 0; d < 3; d++) {
+      min[d] = position[d] < min[d] ? position[d] : min[d];
+      max[d] = position[d] > max[d] ? position[d] : max[d];
+    }
+  }
+};
+
+// Everything the diagnostics report
+struct diagnostics {
+  double kinetic_energy;
+  bounds box;
+
+  KOKKOS_INLINE_FUNCTION void init() {
+    kinetic_energy = 0;
+    box.init();
+  }
+
+  KOKKOS_INLINE_FUNCTION void join(const diagnostics& other) {
+    kinetic_energy += other.kinetic_energy;
+    box.join(other.box);
+  }
+
+  template<class Access>
+  KOKKOS_INLINE_FUNCTION void add(const Access& p, const size_t i) {
+    kinetic_energy += kinetic(p, i);
+    box.add(p, i);
+  }
+
+  // kinetic energy of a unit mass particle, or 0 if it is not finite
+  template<class Access>
+  KOKKOS_INLINE_FUNCTION static double kinetic(const Access& p, const size_t i) {
+    const double energy = 0.5*(p.x_vel(i)*p.x_vel(i) + p.y_vel(i)*p.y_vel(i) + p.z_vel(i)*p.z_vel(i));
+    return finite(energy) ? energy : 0;
+  }
+};
+
+// Kokkos reducer for any value type with init() and join()
+template<class Value, class Space = Kokkos::HostSpace>
+struct reducer {
+  typedef reducer reducer_type;
+  typedef Value value_type;
+  typedef Kokkos::View<value_type, Space, Kokkos::MemoryTraits<Kokkos::Unmanaged>> result_view_type;
+
+  value_type& value;
+
+  KOKKOS_INLINE_FUNCTION reducer(value_type& value) : value(value) {}
+
+  KOKKOS_INLINE_FUNCTION void join(value_type& dst, const value_type& src) const {
+    dst.join(src);
+  }
+
+  KOKKOS_INLINE_FUNCTION void join(volatile value_type& dst, const volatile value_type& src) const {
+    value_type a = const_cast<value_type&>(dst);
+    a.join(const_cast<const value_type&>(src));
+    const_cast<value_type&>(dst) = a;
+  }
+
+  KOKKOS_INLINE_FUNCTION void init(value_type& v) const {
+    v.init();
+  }
+
+  KOKKOS_INLINE_FUNCTION value_type& reference() const {
+    return value;
+  }
+
+  result_view_type view() const {
+    return result_view_type(&value);
+  }
+};
+
+} // namespace euler_reduce
+
+// Total kinetic energy, a scalar sum over the three velocity fields
+template<class Particles>
+struct kinetic_energy {
+  const size_t n;
+
+  Particles state;
+  double energy = 0;
+
+  std::vector<uint64_t> times;
+
+  kinetic_energy(size_t n) : n(n), state(n) {
+  }
+
+  void test() {
+    const euler_access<Particles> p(state);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_reduce("kinetic_energy::test", n, KOKKOS_LAMBDA(const size_t& i, double& sum) {
+      sum += euler_reduce::diagnostics::kinetic(p, i);
+    }, energy);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    std::cout << "    Energy: " << energy << std::endl;
+  }
+};
+
+// Bounding box and live count, a multi-value reduction over four fields
+template<class Particles>
+struct bounding_box {
+  const size_t n;
+
+  Particles state;
+  euler_reduce::bounds box;
+
+  std::vector<uint64_t> times;
+
+  bounding_box(size_t n) : n(n), state(n) {
+  }
+
+  void test() {
+    const euler_access<Particles> p(state);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_reduce("bounding_box::test", n, KOKKOS_LAMBDA(const size_t& i, euler_reduce::bounds& local) {
+      local.add(p, i);
+    }, euler_reduce::reducer<euler_reduce::bounds>(box));
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    std::cout << "    Live: " << box.live << "; Box: ("
+              << box.min[0] << ", " << box.min[1] << ", " << box.min[2] << ") to ("
+              << box.max[0] << ", " << box.max[1] << ", " << box.max[2] << ")" << std::endl;
+  }
+};
+
+// An Euler step followed by the diagnostics, either fused into one pass over
+// the particles or as the plain step kernel then a separate reduction
+template<class Particles, bool Fused>
+struct integrate_reduce {
+  const size_t n;
+
+  Particles state;
+  euler_reduce::diagnostics result;
+
+  std::vector<uint64_t> times;
+
+  integrate_reduce(size_t n) : n(n), state(n) {
+  }
+
+  void test() {
+    const euler_access<Particles> p(state);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (Fused) {
+      Kokkos::parallel_reduce("integrate_reduce::fused", n, KOKKOS_LAMBDA(const size_t& i, euler_reduce::diagnostics& local) {
+        euler_integrate(p, i);
+        local.add(p, i);
+      }, euler_reduce::reducer<euler_reduce::diagnostics>(result));
+    } else {
+      state.step(n);
+      Kokkos::parallel_reduce("integrate_reduce::diagnostics", n, KOKKOS_LAMBDA(const size_t& i, euler_reduce::diagnostics& local) {
+        local.add(p, i);
+      }, euler_reduce::reducer<euler_reduce::diagnostics>(result));
+    }
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    std::cout << "    Energy: " << result.kinetic_energy << "; Live: " << result.box.live << std::endl;
+  }
+};
+
+#endif // EULER_REDUCE_HPP
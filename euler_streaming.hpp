@@ -0,0 +1,362 @@
+
+// Out-of-core Euler integration
+// The particles live in a checkpoint file and are streamed through a small
+// ring of in-memory chunks: a reader thread loads ahead, the calling thread
+// integrates, and a writer thread stores the results behind it
+
+#ifndef EULER_STREAMING_HPP
+#define EULER_STREAMING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "checkpoint.hpp"
+#include "euler_particle.hpp"
+
+namespace streaming {
+
+// Blocking FIFO of chunk slot indices, used to hand slots between threads
+class slot_queue {
+public:
+  void push(size_t slot) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _slots.push_back(slot);
+    }
+    _ready.notify_one();
+  }
+
+  size_t pop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _ready.wait(lock, [this]() { return !_slots.empty(); });
+    const size_t slot = _slots.front();
+    _slots.pop_front();
+    return slot;
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  std::deque<size_t> _slots;
+};
+
+// File backed particle set, stored in the checkpoint format
+class backing_file {
+public:
+  backing_file(const std::string& path, size_t n)
+    : _path(path), _head(checkpoint::euler_schema::make_header(n)) {
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+      throw std::runtime_error("streaming: unable to create " + path);
+    }
+    if (ftruncate(_fd, _head.file_size) != 0
+        || pwrite(_fd, &_head, sizeof(_head), 0) != ssize_t(sizeof(_head))) {
+      ::close(_fd);
+      throw std::runtime_error("streaming: unable to initialize " + path);
+    }
+  }
+
+  backing_file(const backing_file&) = delete;
+  backing_file& operator=(const backing_file&) = delete;
+
+  ~backing_file() {
+    ::close(_fd);
+    unlink(_path.c_str());
+  }
+
+  size_t n() const { return _head.n; }
+
+  // reads count entries of field, starting at particle first
+  template<class T>
+  void read(uint32_t field, size_t first, size_t count, T* buffer) const {
+    transfer(field, first, count, buffer, true);
+  }
+
+  template<class T>
+  void write(uint32_t field, size_t first, size_t count, const T* buffer) const {
+    transfer(field, first, count, const_cast<T*>(buffer), false);
+  }
+
+private:
+  template<class T>
+  void transfer(uint32_t field, size_t first, size_t count, T* buffer, bool reading) const {
+    char* data = reinterpret_cast<char*>(buffer);
+    size_t remaining = count*sizeof(T);
+    off_t offset = _head.fields[field].offset + first*sizeof(T);
+    while (remaining > 0) {
+      const ssize_t done = reading ? pread(_fd, data, remaining, offset)
+                                   : pwrite(_fd, data, remaining, offset);
+      if (done <= 0) {
+        throw std::runtime_error("streaming: I/O error on " + _path);
+      }
+      data += done;
+      offset += done;
+      remaining -= done;
+    }
+  }
+
+  const std::string _path;
+  const checkpoint::header _head;
+  int _fd;
+};
+
+// Moves the SoA fields of particles [first, first+count) between the file and
+// a LayoutLeft particle set
+template<class Particles>
+void read_fields(const backing_file& file, size_t first, size_t count, Particles& p) {
+  file.read( 0, first, count, p.x_accel.data());
+  file.read( 1, first, count, p.y_accel.data());
+  file.read( 2, first, count, p.z_accel.data());
+  file.read( 3, first, count, p.x_vel.data());
+  file.read( 4, first, count, p.y_vel.data());
+  file.read( 5, first, count, p.z_vel.data());
+  file.read( 6, first, count, p.x.data());
+  file.read( 7, first, count, p.y.data());
+  file.read( 8, first, count, p.z.data());
+  file.read( 9, first, count, p.lifetime.data());
+  file.read(10, first, count, p.x_resistance.data());
+  file.read(11, first, count, p.y_resistance.data());
+  file.read(12, first, count, p.z_resistance.data());
+}
+
+template<class Particles>
+void write_fields(const backing_file& file, size_t first, size_t count, const Particles& p) {
+  file.write( 0, first, count, p.x_accel.data());
+  file.write( 1, first, count, p.y_accel.data());
+  file.write( 2, first, count, p.z_accel.data());
+  file.write( 3, first, count, p.x_vel.data());
+  file.write( 4, first, count, p.y_vel.data());
+  file.write( 5, first, count, p.z_vel.data());
+  file.write( 6, first, count, p.x.data());
+  file.write( 7, first, count, p.y.data());
+  file.write( 8, first, count, p.z.data());
+  file.write( 9, first, count, p.lifetime.data());
+  file.write(10, first, count, p.x_resistance.data());
+  file.write(11, first, count, p.y_resistance.data());
+  file.write(12, first, count, p.z_resistance.data());
+}
+
+// In-memory chunk of particles
+// The LayoutLeft chunk is read into directly; the LayoutRight chunk is read
+// into a SoA staging area and transposed around the integration step
+template<class Layout>
+struct chunk {
+};
+
+template<>
+struct chunk<Kokkos::LayoutLeft> {
+  euler_particles<Kokkos::LayoutLeft> particles;
+
+  chunk(size_t n) : particles(n) {}
+
+  void load(const backing_file& file, size_t first, size_t count) {
+    read_fields(file, first, count, particles);
+  }
+
+  void store(const backing_file& file, size_t first, size_t count) {
+    write_fields(file, first, count, particles);
+  }
+
+  void step(size_t count) {
+    particles.step(count);
+    Kokkos::fence();
+  }
+};
+
+template<>
+struct chunk<Kokkos::LayoutRight> {
+  euler_particles<Kokkos::LayoutLeft> staging;
+  euler_particles<Kokkos::LayoutRight> particles;
+
+  chunk(size_t n) : staging(n), particles(n) {}
+
+  void load(const backing_file& file, size_t first, size_t count) {
+    read_fields(file, first, count, staging);
+  }
+
+  void store(const backing_file& file, size_t first, size_t count) {
+    write_fields(file, first, count, staging);
+  }
+
+  void step(size_t count) {
+    auto s = staging;
+    auto p = particles.particles;
+
+    Kokkos::parallel_for("streaming::unpack", count, KOKKOS_LAMBDA(const size_t& i) {
+      p(i).x_accel      = s.x_accel(i);
+      p(i).y_accel      = s.y_accel(i);
+      p(i).z_accel      = s.z_accel(i);
+      p(i).x_vel        = s.x_vel(i);
+      p(i).y_vel        = s.y_vel(i);
+      p(i).z_vel        = s.z_vel(i);
+      p(i).x            = s.x(i);
+      p(i).y            = s.y(i);
+      p(i).z            = s.z(i);
+      p(i).lifetime     = s.lifetime(i);
+      p(i).x_resistance = s.x_resistance(i);
+      p(i).y_resistance = s.y_resistance(i);
+      p(i).z_resistance = s.z_resistance(i);
+    });
+
+    particles.step(count);
+
+    // only the integrated fields need to go back
+    Kokkos::parallel_for("streaming::pack", count, KOKKOS_LAMBDA(const size_t& i) {
+      s.x_vel(i)    = p(i).x_vel;
+      s.y_vel(i)    = p(i).y_vel;
+      s.z_vel(i)    = p(i).z_vel;
+      s.x(i)        = p(i).x;
+      s.y(i)        = p(i).y;
+      s.z(i)        = p(i).z;
+      s.lifetime(i) = p(i).lifetime;
+    });
+    Kokkos::fence();
+  }
+};
+
+} // namespace streaming
+
+// Euler integration of a particle set that only exists in a file
+// Each trial is one full time step over every particle
+template<class Layout>
+struct euler_streaming {
+  static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace,
+                                           Kokkos::DefaultExecutionSpace::memory_space>::accessible,
+                "streaming reads directly into particle Views, so they must be in host memory");
+
+  // particles per chunk and chunks in flight (read ahead, integrate, write behind)
+  static constexpr size_t default_chunk_size = 1 << 20;
+  static constexpr size_t default_buffers = 3;
+
+  const size_t n;
+  const size_t chunk_size;
+  const size_t bytes;
+
+  streaming::backing_file file;
+  std::vector<std::unique_ptr<streaming::chunk<Layout>>> chunks;
+
+  std::vector<uint64_t> times;
+
+  // busy time of each pipeline stage, summed over all trials
+  uint64_t read_time = 0;
+  uint64_t compute_time = 0;
+  uint64_t write_time = 0;
+
+  euler_streaming(size_t n, size_t chunk_size = default_chunk_size, size_t buffers = default_buffers)
+    : n(n), chunk_size(std::min(n, chunk_size)),
+      bytes(2*checkpoint::euler_schema::payload(n)),
+      file(checkpoint::path((std::string("stream_") + layout_name<Layout>::value).c_str()), n) {
+    if (n == 0) {
+      throw std::runtime_error("streaming: no particles to stream");
+    }
+    for (size_t i = 0; i < buffers; i++) {
+      chunks.emplace_back(new streaming::chunk<Layout>(this->chunk_size));
+    }
+    setup();
+  }
+
+  // fills the file with the particles of euler_particles(n), one chunk at a
+  // time, so n is never resident
+  void setup() {
+    euler_particles<Kokkos::LayoutLeft> initial(chunk_size);
+    for (size_t first = 0; first < n; first += chunk_size) {
+      initial.setup(first, n);
+      streaming::write_fields(file, first, std::min(chunk_size, n - first), initial);
+    }
+  }
+
+  void test() {
+    typedef std::chrono::high_resolution_clock clock;
+    const size_t chunk_count = (n + chunk_size - 1)/chunk_size;
+
+    streaming::slot_queue free_slots, loaded, integrated;
+    for (size_t slot = 0; slot < chunks.size(); slot++) {
+      free_slots.push(slot);
+    }
+
+    auto t1 = clock::now();
+
+    uint64_t reading = 0;
+    std::thread reader([&]() {
+      for (size_t k = 0; k < chunk_count; k++) {
+        const size_t slot = free_slots.pop();
+        auto r1 = clock::now();
+        chunks[slot]->load(file, k*chunk_size, std::min(chunk_size, n - k*chunk_size));
+        auto r2 = clock::now();
+        reading += std::chrono::duration_cast<std::chrono::nanoseconds>(r2 - r1).count();
+        loaded.push(slot);
+      }
+    });
+
+    uint64_t writing = 0;
+    std::thread writer([&]() {
+      for (size_t k = 0; k < chunk_count; k++) {
+        const size_t slot = integrated.pop();
+        auto w1 = clock::now();
+        chunks[slot]->store(file, k*chunk_size, std::min(chunk_size, n - k*chunk_size));
+        auto w2 = clock::now();
+        writing += std::chrono::duration_cast<std::chrono::nanoseconds>(w2 - w1).count();
+        free_slots.push(slot);
+      }
+    });
+
+    for (size_t k = 0; k < chunk_count; k++) {
+      const size_t slot = loaded.pop();
+      auto c1 = clock::now();
+      chunks[slot]->step(std::min(chunk_size, n - k*chunk_size));
+      auto c2 = clock::now();
+      compute_time += std::chrono::duration_cast<std::chrono::nanoseconds>(c2 - c1).count();
+      integrated.push(slot);
+    }
+
+    reader.join();
+    writer.join();
+    auto t2 = clock::now();
+
+    read_time += reading;
+    write_time += writing;
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  // Overlap efficiency is the fraction of the achievable saving over running
+  // the stages back to back that was actually realised: 1 means the step took
+  // only as long as the slowest stage, 0 means nothing overlapped, and
+  // negative values mean the pipeline was slower than running the stages back
+  // to back. With a single chunk nothing can overlap, so it is not given
+  void report() const {
+    const size_t chunk_count = (n + chunk_size - 1)/chunk_size;
+    uint64_t wall = 0;
+    for (uint64_t time : times) {
+      wall += time;
+    }
+    const double serial = double(read_time) + compute_time + write_time;
+    const double bound = std::max(double(compute_time), double(std::max(read_time, write_time)));
+    const double efficiency = serial > bound ? (serial - wall)/(serial - bound) : 1.0;
+
+    std::cout << "    Read: " << read_time/1e6/times.size() << " (ms); "
+              << "Compute: " << compute_time/1e6/times.size() << " (ms); "
+              << "Write: " << write_time/1e6/times.size() << " (ms); "
+              << "Overlap efficiency: ";
+    if (chunk_count < 2) {
+      std::cout << "n/a" << std::endl;
+    } else {
+      std::cout << efficiency << std::endl;
+    }
+  }
+};
+
+#endif // EULER_STREAMING_HPP
@@ -0,0 +1,158 @@
+
+// Memory footprint of the tests
+// Reports, for each test:
+//  * the bytes Kokkos allocated for its Views, through the Kokkos Tools
+//    allocation callbacks, and the most live at once
+//  * the change in resident set size (from /proc/self/smaps_rollup) from
+//    constructing it and from running its trials, which unlike the Views
+//    counts only the pages actually touched
+//  * the peak resident set size while it ran, from VmHWM after resetting it
+// so results do not depend on what earlier tests left behind
+// Memory freed by earlier tests is returned to the system before each test,
+// otherwise the allocator reuses pages that are already resident
+
+#ifndef FOOTPRINT_HPP
+#define FOOTPRINT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <string>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace footprint {
+
+// Value in kB of the line starting with key in a /proc file, or -1
+inline long read_kb(const char* path, const char* key) {
+  std::ifstream file(path);
+  std::string line;
+  const size_t length = std::strlen(key);
+  while (std::getline(file, line)) {
+    if (line.compare(0, length, key) == 0) {
+      return std::stol(line.substr(length));
+    }
+  }
+  return -1;
+}
+
+// Resident set size in kB
+// smaps_rollup sums the page tables, where VmRSS uses counters that may lag
+inline long rss_kb() {
+  const long rss = read_kb("/proc/self/smaps_rollup", "Rss:");
+  return rss >= 0 ? rss : read_kb("/proc/self/status", "VmRSS:");
+}
+
+// Peak resident set size in kB since the process started or reset_peak
+inline long peak_kb() {
+  return read_kb("/proc/self/status", "VmHWM:");
+}
+
+// Resets the peak resident set size to the current one, returning false if
+// the kernel does not allow it
+inline bool reset_peak() {
+  std::ofstream file("/proc/self/clear_refs");
+  file << "5";
+  file.flush();
+  return bool(file);
+}
+
+// Bytes of the Views Kokkos has allocated
+struct views {
+  // whether the allocation callbacks are installed
+  bool counted = false;
+  int64_t live = 0;
+  int64_t peak = 0;
+  size_t allocations = 0;
+};
+
+inline views& kokkos() {
+  static views v;
+  return v;
+}
+
+inline void allocate(Kokkos::Tools::SpaceHandle, const char*, const void*, const uint64_t size) {
+  views& v = kokkos();
+  v.live += size;
+  v.peak = std::max(v.peak, v.live);
+  v.allocations++;
+}
+
+inline void deallocate(Kokkos::Tools::SpaceHandle, const char*, const void*, const uint64_t size) {
+  kokkos().live -= size;
+}
+
+// Registers the callbacks, once after Kokkos::initialize, unless a tool
+// loaded through KOKKOS_TOOLS_LIBS has them, as they would replace its own
+inline void install() {
+  if (Kokkos::Profiling::profileLibraryLoaded()) {
+    return;
+  }
+  kokkos().counted = true;
+  Kokkos::Tools::Experimental::set_allocate_data_callback(allocate);
+  Kokkos::Tools::Experimental::set_deallocate_data_callback(deallocate);
+}
+
+// Footprint of one test
+struct probe {
+  long rss_start = 0;
+  long rss_constructed = 0;
+  long rss_end = 0;
+  long peak = 0;
+  bool peak_reset = false;
+
+  int64_t views_start = 0;
+  int64_t views_constructed = 0;
+  int64_t views_peak = 0;
+  size_t allocations = 0;
+
+  // just before the test is constructed
+  void start() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    peak_reset = reset_peak();
+    views& v = kokkos();
+    v.peak = v.live;
+    views_start = v.live;
+    allocations = v.allocations;
+    rss_start = rss_kb();
+  }
+
+  // once it is constructed
+  void constructed() {
+    rss_constructed = rss_kb();
+    views_constructed = kokkos().live;
+    allocations = kokkos().allocations - allocations;
+  }
+
+  // after the trials
+  void stop() {
+    rss_end = rss_kb();
+    peak = peak_kb();
+    views_peak = kokkos().peak;
+  }
+
+  void print() const {
+    std::cout << "    Footprint: ";
+    if (kokkos().counted) {
+      std::cout << "Views: " << (views_constructed - views_start)/1024.0/1024.0 << " (MB) in "
+                << allocations << " allocations, at most " << (views_peak - views_start)/1024.0/1024.0 << " (MB); ";
+    }
+    std::cout << "RSS: +" << (rss_constructed - rss_start)/1024.0 << " (MB) constructed, "
+              << "+" << (rss_end - rss_constructed)/1024.0 << " (MB) in trials; ";
+    if (peak_reset) {
+      std::cout << "Peak RSS: +" << (peak - rss_start)/1024.0 << " (MB)" << std::endl;
+    } else {
+      std::cout << "Peak RSS of process: " << peak/1024.0 << " (MB)" << std::endl;
+    }
+  }
+};
+
+} // namespace footprint
+
+#endif // FOOTPRINT_HPP
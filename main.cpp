@@ -5,24 +5,37 @@
 #include<Kokkos_Core.hpp>
 #include<cstdlib>
 #include<iostream>
+#include<string>
+#include<utility>
+#include<vector>
 
 #include "copy.hpp"
 #include "copy_mixed.hpp"
+#include "copy_indirect.hpp"
+#include "copy_subset.hpp"
 #include "euler_particle.hpp"
+#include "euler_reduce.hpp"
+#include "euler_emission.hpp"
+#include "euler_classes.hpp"
+#include "migration.hpp"
+#include "adaptive_layout.hpp"
+#include "euler_streaming.hpp"
+#include "particle_interaction.hpp"
+#include "morton_reorder.hpp"
 #include "capacity.hpp"
+#include "checkpoint.hpp"
+#include "stats.hpp"
+#include "roofline.hpp"
+#include "startup.hpp"
+#include "footprint.hpp"
+#include "throughput.hpp"
+#include "native.hpp"
+#include "trace.hpp"
 
 
-// t values for 99% confidence iterval
-constexpr double t_values_99[] = {
-    63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.49, 3.355, 3.250, 3.169,
-     3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
-     2.831, 2.819, 2.807, 2.797, 2.787, 2.779, 2.771, 2.763, 2.756, 2.750,
-     2.744, 2.738, 2.733, 2.728, 2.724, 2.719, 2.715, 2.712, 2.708, 2.704
-  };
-
 // Computes mean, standard deviation, ect of the execution times for the given test
 template<class Test>
-void compute_stats(const Test& t, const size_t trials) {
+stats::sample compute_stats(const Test& t, const size_t trials) {
   // total time in ns
   size_t total = 0;
   for (size_t time : t.times) {
@@ -40,62 +53,435 @@ void compute_stats(const Test& t, const size_t trials) {
   // sample standard deviation
   const double std_dev = std::sqrt(total_varience/(trials-1));
 
-  const double ci_99 = t_values_99[(trials <= 40?trials:40)-1]*std_dev/std::sqrt(trials);
+  const double ci_99 = stats::t_value_99(trials-1)*std_dev/std::sqrt(trials);
 
   std::cout << "Mean: " << mean/1000.0/1000.0 << " (ms); "
       << "Stdev: " << std_dev/1000.0/1000.0  << " (ms); "
       << "99% CI: " << ci_99/1000.0/1000.0 << " (ms)" <<  std::endl;
+
+  return stats::sample{trials, double(total)/trials, std_dev};
+}
+
+// Tests with a `bytes` member report the bandwidth of moving that many bytes per trial
+template<class Test>
+auto print_bandwidth(const Test& t, int) -> decltype(size_t(t.bytes), void()) {
+  size_t total = 0;
+  for (size_t time : t.times) {
+    total += time;
+  }
+  // bytes per ns is GB/s
+  const double mean = double(total)/t.times.size();
+  std::cout << "    Bandwidth: " << t.bytes/mean << " (GB/s)" << std::endl;
 }
 
 template<class Test>
-void run_test(const char* name, const size_t n, const size_t trials) {
-  Test test (n);
+void print_bandwidth(const Test&, long) {
+}
+
+// Tests with `flops` and `bytes` members are placed on the roofline, once it is calibrated
+template<class Test>
+auto print_roofline(const Test& t, int) -> decltype(double(t.flops), double(t.bytes), void()) {
+  if (!roofline::measured().calibrated) {
+    return;
+  }
+  size_t total = 0;
+  for (size_t time : t.times) {
+    total += time;
+  }
+  roofline::print(t.flops, t.bytes, double(total)/t.times.size());
+}
+
+template<class Test>
+void print_roofline(const Test&, long) {
+}
+
+// Tests with a `report` member print their own extra results
+template<class Test>
+auto print_report(const Test& t, int) -> decltype(t.report(), void()) {
+  t.report();
+}
+
+template<class Test>
+void print_report(const Test&, long) {
+}
+
+template<class Test, class... Args>
+void run_test(const char* name, const size_t n, const size_t trials, const Args&... args) {
+  trace::begin(name, "test");
+  footprint::probe memory;
+  memory.start();
+  trace::begin("setup", "test");
+  startup::start();
+  Test test (n, args...);
+  const startup::profile profile = startup::stop();
+  trace::end("test");
+  memory.constructed();
 
   for (size_t i = 0; i < trials; i++) {
+    trace::begin("trial", "test", i);
     test.test();
+    trace::end("test");
   }
+  memory.stop();
+  trace::end("test");
 
   std::cout << name << "  ";
-  compute_stats(test, trials);
+  stats::current().add(name, compute_stats(test, trials));
+  print_bandwidth(test, 0);
+  print_roofline(test, 0);
+  startup::print(profile);
+  memory.print();
+  print_report(test, 0);
+}
+
+// Runs the gather and scatter versions of every copy test with one index pattern
+void run_indirect_tests(const index_pattern pattern, const size_t n, const size_t trials) {
+  stats::section(std::string("Indirect copy kernels, ") + index_pattern_name(pattern) + " indices");
+  run_test<copy_gather<copy<Kokkos::LayoutLeft>>>("gather  2dview left ", n, trials, pattern);
+  run_test<copy_gather<copy<Kokkos::LayoutRight>>>("gather  2dview right", n, trials, pattern);
+  run_test<copy_gather<copy_struct<Kokkos::LayoutLeft>>>("gather         left ", n, trials, pattern);
+  run_test<copy_gather<copy_struct<Kokkos::LayoutRight>>>("gather         right", n, trials, pattern);
+  run_test<copy_gather<copy_vos<Kokkos::LayoutLeft>>>("gather  VoS    left ", n, trials, pattern);
+  run_test<copy_gather<copy_vos<Kokkos::LayoutRight>>>("gather  VoS    right", n, trials, pattern);
+  run_test<copy_gather<copy_mixed<Kokkos::LayoutLeft>>>("gather  mixed  left ", n, trials, pattern);
+  run_test<copy_gather<copy_mixed<Kokkos::LayoutRight>>>("gather  mixed  right", n, trials, pattern);
+  run_test<copy_gather<copy_mixed_vos<Kokkos::LayoutLeft>>>("gather  mixVoS left ", n, trials, pattern);
+  run_test<copy_gather<copy_mixed_vos<Kokkos::LayoutRight>>>("gather  mixVoS right", n, trials, pattern);
+
+  run_test<copy_scatter<copy<Kokkos::LayoutLeft>>>("scatter 2dview left ", n, trials, pattern);
+  run_test<copy_scatter<copy<Kokkos::LayoutRight>>>("scatter 2dview right", n, trials, pattern);
+  run_test<copy_scatter<copy_struct<Kokkos::LayoutLeft>>>("scatter        left ", n, trials, pattern);
+  run_test<copy_scatter<copy_struct<Kokkos::LayoutRight>>>("scatter        right", n, trials, pattern);
+  run_test<copy_scatter<copy_vos<Kokkos::LayoutLeft>>>("scatter VoS    left ", n, trials, pattern);
+  run_test<copy_scatter<copy_vos<Kokkos::LayoutRight>>>("scatter VoS    right", n, trials, pattern);
+  run_test<copy_scatter<copy_mixed<Kokkos::LayoutLeft>>>("scatter mixed  left ", n, trials, pattern);
+  run_test<copy_scatter<copy_mixed<Kokkos::LayoutRight>>>("scatter mixed  right", n, trials, pattern);
+  run_test<copy_scatter<copy_mixed_vos<Kokkos::LayoutLeft>>>("scatter mixVoS left ", n, trials, pattern);
+  run_test<copy_scatter<copy_mixed_vos<Kokkos::LayoutRight>>>("scatter mixVoS right", n, trials, pattern);
+}
+
+// Runs a test over raw buffers in both layouts, with each engine this build has
+template<template<class, class> class Test>
+void run_native_tests(const size_t n, const size_t trials) {
+#ifdef NATIVE_PAR_UNSEQ
+  run_test<Test<native::par_unseq, Kokkos::LayoutLeft>>("par_unseq   left ", n, trials);
+  run_test<Test<native::par_unseq, Kokkos::LayoutRight>>("par_unseq   right", n, trials);
+#else
+  std::cout << "par_unseq         not built: " << native::par_unseq_missing << std::endl;
+#endif
+#ifdef _OPENMP
+  run_test<Test<native::openmp, Kokkos::LayoutLeft>>("omp simd    left ", n, trials);
+  run_test<Test<native::openmp, Kokkos::LayoutRight>>("omp simd    right", n, trials);
+#else
+  std::cout << "omp simd          not built: needs OpenMP (e.g. KOKKOS_DEVICES=OpenMP)" << std::endl;
+#endif
+}
+
+// Runs the copy and Euler tests with Views that have the given memory traits
+// The ViewOfStructs tests are left out, as ViewOfStructs takes no traits
+template<unsigned Traits>
+void run_traits_tests(const char* traits, const size_t n, const size_t trials) {
+  stats::section(std::string("Kernels with ") + traits + " Views");
+  run_test<copy<Kokkos::LayoutLeft, Traits>>("copy 2dview left ", n, trials);
+  run_test<copy<Kokkos::LayoutRight, Traits>>("copy 2dview right", n, trials);
+  run_test<copy_struct<Kokkos::LayoutLeft, Traits>>("copy        left ", n, trials);
+  run_test<copy_struct<Kokkos::LayoutRight, Traits>>("copy        right", n, trials);
+  run_test<copy_mixed<Kokkos::LayoutLeft, Traits>>("mixed       left ", n, trials);
+  run_test<copy_mixed<Kokkos::LayoutRight, Traits>>("mixed       right", n, trials);
+  run_test<record_copy<record_view<euler_particle_struct, Kokkos::LayoutLeft, Traits>>>("record      left ", n, trials);
+  run_test<record_copy<record_view<euler_particle_struct, Kokkos::LayoutRight, Traits>>>("record      right", n, trials);
+  run_test<euler_particles<Kokkos::LayoutLeft, Traits>>("euler       left ", n, trials);
+  run_test<euler_particles<Kokkos::LayoutRight, Traits>>("euler       right", n, trials);
+}
+
+template<class Copy, int Count>
+void run_subset_test(const char* name, const size_t n, const size_t trials) {
+  const std::string label = std::string(name) + " " + std::to_string(Count) + " fields";
+  run_test<copy_subset<Copy, first_fields(Count)>>(label.c_str(), n, trials);
+}
+
+template<class Copy, size_t... Count>
+void run_subset_sweep(const char* name, const size_t n, const size_t trials, std::index_sequence<Count...>) {
+  const int expand[] = {(run_subset_test<Copy, Count + 1>(name, n, trials), 0)...};
+  (void) expand;
+}
+
+// Runs a copy test touching the first 1, 2, ..., Copy::fields fields
+template<class Copy>
+void run_subset_sweep(const char* name, const size_t n, const size_t trials) {
+  run_subset_sweep<Copy>(name, n, trials, std::make_index_sequence<Copy::fields>());
+}
+
+// Tests that can be run in throughput mode, each in every layout
+const std::vector<throughput::entry>& throughput_tests() {
+  static const std::vector<throughput::entry> tests = {
+    {"copy", "2dview left ", throughput::instance<copy<Kokkos::LayoutLeft>>},
+    {"copy", "2dview right", throughput::instance<copy<Kokkos::LayoutRight>>},
+    {"copy", "       left ", throughput::instance<copy_struct<Kokkos::LayoutLeft>>},
+    {"copy", "       right", throughput::instance<copy_struct<Kokkos::LayoutRight>>},
+    {"copy", "VoS    left ", throughput::instance<copy_vos<Kokkos::LayoutLeft>>},
+    {"copy", "VoS    right", throughput::instance<copy_vos<Kokkos::LayoutRight>>},
+    {"mixed", "       left ", throughput::instance<copy_mixed<Kokkos::LayoutLeft>>},
+    {"mixed", "       right", throughput::instance<copy_mixed<Kokkos::LayoutRight>>},
+    {"mixed", "VoS    left ", throughput::instance<copy_mixed_vos<Kokkos::LayoutLeft>>},
+    {"mixed", "VoS    right", throughput::instance<copy_mixed_vos<Kokkos::LayoutRight>>},
+    {"euler", "       left ", throughput::instance<euler_particles<Kokkos::LayoutLeft>>},
+    {"euler", "       right", throughput::instance<euler_particles<Kokkos::LayoutRight>>},
+    {"euler", "sov    left ", throughput::instance<euler_particles_vos<Kokkos::LayoutLeft>>},
+    {"euler", "sov    right", throughput::instance<euler_particles_vos<Kokkos::LayoutRight>>},
+  };
+  return tests;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc < 3) {
-    printf("Arguments: N tests\n");
+  // options, then the positional arguments
+  std::string save_path;
+  std::string baseline_path;
+  std::string trace_path;
+  double threshold = 5;
+  bool calibrate = false;
+  size_t instances = 0;
+  std::string throughput_test = "copy";
+  int instance = -1;
+  std::vector<char*> args;
+  for (int i = 0; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 7, "--save=") == 0) {
+      save_path = arg.substr(7);
+    } else if (arg.compare(0, 10, "--compare=") == 0) {
+      baseline_path = arg.substr(10);
+    } else if (arg.compare(0, 12, "--threshold=") == 0) {
+      threshold = atof(arg.c_str() + 12);
+    } else if (arg.compare(0, 8, "--trace=") == 0) {
+      trace_path = arg.substr(8);
+    } else if (arg == "--roofline") {
+      calibrate = true;
+    } else if (arg.compare(0, 13, "--throughput=") == 0) {
+      instances = atoi(arg.c_str() + 13);
+    } else if (arg.compare(0, 7, "--test=") == 0) {
+      throughput_test = arg.substr(7);
+    } else if (arg.compare(0, 11, "--instance=") == 0) {
+      instance = atoi(arg.c_str() + 11);
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+
+  if (args.size() < 3) {
+    printf("Arguments: [options] N tests\n");
     printf("  N:   Number of vector entries\n");
     printf("  tests: number of times each kernels should be run\n");
+    printf("  reorder: steps between Morton reorders (optional, default 10)\n");
+    printf("  emit: particles emitted per step (optional, default N/100)\n");
+    printf("Options:\n");
+    printf("  --save=FILE: write the results as a baseline\n");
+    printf("  --compare=FILE: compare with a baseline, failing if any test regressed\n");
+    printf("  --threshold=PERCENT: slowdown counted as a regression (default 5)\n");
+    printf("  --trace=FILE: write a timeline of every kernel, fence and trial as Chrome trace JSON\n");
+    printf("  --roofline: measure peak bandwidth and flop rate, and place tests on the roofline\n");
+    printf("  --throughput=M: only run M concurrent instances of one test, each on its own cores\n");
+    printf("  --test=NAME: test run by --throughput: copy, mixed or euler (default copy)\n");
         return 1;
   }
 
+  // one of the instances started by throughput mode
+  if (instance >= 0) {
+    if (size_t(instance) >= throughput_tests().size()) {
+      return 1;
+    }
+    Kokkos::initialize();
+    throughput_tests()[instance].run(atoi(args[1]), atoi(args[2]));
+    Kokkos::finalize();
+    return 0;
+  }
+
+  // instances are started before Kokkos is, so no threads are running
+  if (instances > 0) {
+    return throughput::run(throughput_tests(), throughput_test, instances, args[1], args[2]) ? 0 : 1;
+  }
+
+  // a single trial has no spread to test a change against
+  if ((!save_path.empty() || !baseline_path.empty()) && atoi(args[2]) < 2) {
+    std::cerr << "Saving or comparing a baseline needs at least 2 trials" << std::endl;
+    return 1;
+  }
+
+  stats::results baseline;
+  if (!baseline_path.empty() && !baseline.load(baseline_path)) {
+    std::cerr << "Cannot read baseline " << baseline_path << std::endl;
+    return 1;
+  }
+
   Kokkos::initialize();
+  startup::install();
+  footprint::install();
+  if (!trace_path.empty()) {
+    if (!trace::install()) {
+      std::cerr << "Cannot trace while a Kokkos tool is loaded" << std::endl;
+      Kokkos::finalize();
+      return 1;
+    }
+    trace::start();
+  }
 
-  const size_t n = atoi(argv[1]);
-  const size_t trials = atoi(argv[2]);
+  const size_t n = atoi(args[1]);
+  const size_t trials = atoi(args[2]);
+  const size_t reorder_interval = args.size() > 3 ? atoi(args[3]) : 10;
+  const size_t emit = args.size() > 4 ? atoi(args[4]) : n/100;
+
+  if (calibrate) {
+    roofline::calibrate();
+  }
 
-  std::cout << "Copy kernel with only doubles" << std::endl;
+  stats::section("Copy kernel with only doubles");
   run_test<copy<Kokkos::LayoutLeft>>("copy 2dview left ", n, trials);
   run_test<copy<Kokkos::LayoutRight>>("copy 2dview right", n, trials);
   run_test<copy_struct<Kokkos::LayoutLeft>>("copy        left ", n, trials);
   run_test<copy_struct<Kokkos::LayoutRight>>("copy        right", n, trials);
   run_test<copy_vos<Kokkos::LayoutLeft>>("copy VoS    left ", n, trials);
   run_test<copy_vos<Kokkos::LayoutRight>>("copy VoS    right", n, trials);
+  run_native_tests<native_copy>(n, trials);
 
-  std::cout << "Copy kernel with mixed types" << std::endl;
+  stats::section("Copy kernel with mixed types");
   run_test<copy_mixed<Kokkos::LayoutLeft>>("copy        left ", n, trials);
   run_test<copy_mixed<Kokkos::LayoutRight>>("copy        right", n, trials);
   run_test<copy_mixed_vos<Kokkos::LayoutLeft>>("copy VoS    left ", n, trials);
   run_test<copy_mixed_vos<Kokkos::LayoutRight>>("copy VoS    right", n, trials);
+  run_native_tests<native_mixed>(n, trials);
 
-  std::cout << "Euler particle simulation" << std::endl;
+  stats::section("Copy kernel with the Euler particle record");
+  run_test<record_copy<record_view<euler_particle_struct, Kokkos::LayoutLeft>>>("copy        left ", n, trials);
+  run_test<record_copy<record_view<euler_particle_struct, Kokkos::LayoutRight>>>("copy        right", n, trials);
+  run_test<record_copy<record_vos<euler_particle_struct, Kokkos::LayoutLeft>>>("copy VoS    left ", n, trials);
+  run_test<record_copy<record_vos<euler_particle_struct, Kokkos::LayoutRight>>>("copy VoS    right", n, trials);
+
+  stats::section("Copy kernels on a subset of fields");
+  run_subset_sweep<copy_struct<Kokkos::LayoutLeft>>("copy        left ", n, trials);
+  run_subset_sweep<copy_struct<Kokkos::LayoutRight>>("copy        right", n, trials);
+  run_subset_sweep<copy_vos<Kokkos::LayoutLeft>>("copy VoS    left ", n, trials);
+  run_subset_sweep<copy_vos<Kokkos::LayoutRight>>("copy VoS    right", n, trials);
+  run_subset_sweep<copy_mixed<Kokkos::LayoutLeft>>("mixed       left ", n, trials);
+  run_subset_sweep<copy_mixed<Kokkos::LayoutRight>>("mixed       right", n, trials);
+  run_subset_sweep<copy_mixed_vos<Kokkos::LayoutLeft>>("mixed VoS   left ", n, trials);
+  run_subset_sweep<copy_mixed_vos<Kokkos::LayoutRight>>("mixed VoS   right", n, trials);
+
+  run_indirect_tests(index_pattern::identity, n, trials);
+  run_indirect_tests(index_pattern::block_shuffled, n, trials);
+  run_indirect_tests(index_pattern::strided, n, trials);
+  run_indirect_tests(index_pattern::random, n, trials);
+
+  stats::section("Euler particle simulation");
   run_test<euler_particles<Kokkos::LayoutLeft>>("euler       left ", n, trials);
   run_test<euler_particles<Kokkos::LayoutRight>>("euler       right", n, trials);
   run_test<euler_particles_vos<Kokkos::LayoutLeft>>("euler sov   left ", n, trials);
   run_test<euler_particles_vos<Kokkos::LayoutRight>>("euler sov   right", n, trials);
+  run_native_tests<native_euler>(n, trials);
+  run_test<euler_classes_step<euler_particles<Kokkos::LayoutLeft>>>("classes     left ", n, trials);
+  run_test<euler_classes_step<euler_particles<Kokkos::LayoutRight>>>("classes     right", n, trials);
+  run_test<euler_classes_step<euler_particles_vos<Kokkos::LayoutLeft>>>("classes sov left ", n, trials);
+  run_test<euler_classes_step<euler_particles_vos<Kokkos::LayoutRight>>>("classes sov right", n, trials);
+
+  stats::section("Euler particle simulation with mixed resistance classes");
+  run_test<euler_mixed<euler_particles<Kokkos::LayoutLeft>>>("euler mix   left ", n, trials);
+  run_test<euler_mixed<euler_particles<Kokkos::LayoutRight>>>("euler mix   right", n, trials);
+  run_test<euler_mixed<euler_particles_vos<Kokkos::LayoutLeft>>>("euler mixsov left ", n, trials);
+  run_test<euler_mixed<euler_particles_vos<Kokkos::LayoutRight>>>("euler mixsov right", n, trials);
+  run_test<euler_classes_step<euler_particles<Kokkos::LayoutLeft>, true>>("classes mix left ", n, trials);
+  run_test<euler_classes_step<euler_particles<Kokkos::LayoutRight>, true>>("classes mix right", n, trials);
+  run_test<euler_classes_step<euler_particles_vos<Kokkos::LayoutLeft>, true>>("classes mixsov left ", n, trials);
+  run_test<euler_classes_step<euler_particles_vos<Kokkos::LayoutRight>, true>>("classes mixsov right", n, trials);
+
+  run_traits_tests<Kokkos::Restrict>("restrict", n, trials);
+  run_traits_tests<Kokkos::Restrict | Kokkos::Aligned>("restrict aligned", n, trials);
+
+  stats::section("Reductions over Euler particles");
+  run_test<kinetic_energy<euler_particles<Kokkos::LayoutLeft>>>("energy      left ", n, trials);
+  run_test<kinetic_energy<euler_particles<Kokkos::LayoutRight>>>("energy      right", n, trials);
+  run_test<kinetic_energy<euler_particles_vos<Kokkos::LayoutLeft>>>("energy sov  left ", n, trials);
+  run_test<kinetic_energy<euler_particles_vos<Kokkos::LayoutRight>>>("energy sov  right", n, trials);
+  run_test<bounding_box<euler_particles<Kokkos::LayoutLeft>>>("bounds      left ", n, trials);
+  run_test<bounding_box<euler_particles<Kokkos::LayoutRight>>>("bounds      right", n, trials);
+  run_test<bounding_box<euler_particles_vos<Kokkos::LayoutLeft>>>("bounds sov  left ", n, trials);
+  run_test<bounding_box<euler_particles_vos<Kokkos::LayoutRight>>>("bounds sov  right", n, trials);
+  run_test<integrate_reduce<euler_particles<Kokkos::LayoutLeft>, false>>("separate    left ", n, trials);
+  run_test<integrate_reduce<euler_particles<Kokkos::LayoutLeft>, true>>("fused       left ", n, trials);
+  run_test<integrate_reduce<euler_particles<Kokkos::LayoutRight>, false>>("separate    right", n, trials);
+  run_test<integrate_reduce<euler_particles<Kokkos::LayoutRight>, true>>("fused       right", n, trials);
+  run_test<integrate_reduce<euler_particles_vos<Kokkos::LayoutLeft>, false>>("separate sov left ", n, trials);
+  run_test<integrate_reduce<euler_particles_vos<Kokkos::LayoutLeft>, true>>("fused sov   left ", n, trials);
+  run_test<integrate_reduce<euler_particles_vos<Kokkos::LayoutRight>, false>>("separate sov right", n, trials);
+  run_test<integrate_reduce<euler_particles_vos<Kokkos::LayoutRight>, true>>("fused sov   right", n, trials);
+
+  stats::section("Euler particle emission");
+  run_test<euler_emission<euler_particles<Kokkos::LayoutLeft>>>("emit        left ", n, trials, emit);
+  run_test<euler_emission<euler_particles<Kokkos::LayoutRight>>>("emit        right", n, trials, emit);
+  run_test<euler_emission<euler_particles_vos<Kokkos::LayoutLeft>>>("emit sov    left ", n, trials, emit);
+  run_test<euler_emission<euler_particles_vos<Kokkos::LayoutRight>>>("emit sov    right", n, trials, emit);
+
+  stats::section("Particle migration between 4 ranks");
+  run_test<particle_migration<euler_particles<Kokkos::LayoutLeft>>>("migrate     left ", n, trials, 4);
+  run_test<particle_migration<euler_particles<Kokkos::LayoutRight>>>("migrate     right", n, trials, 4);
+  run_test<particle_migration<euler_particles_vos<Kokkos::LayoutLeft>>>("migrate sov left ", n, trials, 4);
+  run_test<particle_migration<euler_particles_vos<Kokkos::LayoutRight>>>("migrate sov right", n, trials, 4);
+
+  stats::section("Adaptive layout, 4 drift steps then a gather");
+  run_test<adaptive_euler>("fixed       left ", n, trials, adaptive::policy::soa, 4);
+  run_test<adaptive_euler>("fixed       right", n, trials, adaptive::policy::aos, 4);
+  run_test<adaptive_euler>("adaptive         ", n, trials, adaptive::policy::adapt, 4);
+
+  stats::section("Adaptive layout, 32 drift steps then a gather");
+  run_test<adaptive_euler>("fixed       left ", n, trials, adaptive::policy::soa, 32);
+  run_test<adaptive_euler>("fixed       right", n, trials, adaptive::policy::aos, 32);
+  run_test<adaptive_euler>("adaptive         ", n, trials, adaptive::policy::adapt, 32);
 
-  std::cout << "Memory usage" << std::endl;
+  stats::section("Binned particle interactions");
+  run_test<particle_interaction<Kokkos::LayoutLeft>>("interact    left ", n, trials);
+  run_test<particle_interaction<Kokkos::LayoutRight>>("interact    right", n, trials);
+  run_test<particle_interaction_vos<Kokkos::LayoutLeft>>("interact sov left ", n, trials);
+  run_test<particle_interaction_vos<Kokkos::LayoutRight>>("interact sov right", n, trials);
+
+  stats::section("Binned particle interactions with Morton reordering");
+  run_test<morton_interaction<particle_interaction<Kokkos::LayoutLeft>>>("never       left ", n, trials, 0);
+  run_test<morton_interaction<particle_interaction<Kokkos::LayoutLeft>>>("reorder     left ", n, trials, reorder_interval);
+  run_test<morton_interaction<particle_interaction<Kokkos::LayoutRight>>>("never       right", n, trials, 0);
+  run_test<morton_interaction<particle_interaction<Kokkos::LayoutRight>>>("reorder     right", n, trials, reorder_interval);
+  run_test<morton_interaction<particle_interaction_vos<Kokkos::LayoutLeft>>>("never   sov left ", n, trials, 0);
+  run_test<morton_interaction<particle_interaction_vos<Kokkos::LayoutLeft>>>("reorder sov left ", n, trials, reorder_interval);
+  run_test<morton_interaction<particle_interaction_vos<Kokkos::LayoutRight>>>("never   sov right", n, trials, 0);
+  run_test<morton_interaction<particle_interaction_vos<Kokkos::LayoutRight>>>("reorder sov right", n, trials, reorder_interval);
+
+#ifndef KOKKOS_ENABLE_CUDA
+  // streaming reads straight into the particle Views, so needs them in host memory
+  stats::section("Out-of-core Euler particle simulation");
+  run_test<euler_streaming<Kokkos::LayoutLeft>>("stream      left ", n, trials);
+  run_test<euler_streaming<Kokkos::LayoutRight>>("stream      right", n, trials);
+#endif
+
+  stats::section("Checkpoint/restart of Euler particles");
+  run_test<checkpoint_write<Kokkos::LayoutLeft>>("write       left ", n, trials);
+  run_test<checkpoint_write<Kokkos::LayoutRight>>("write       right", n, trials);
+  run_test<checkpoint_restart<Kokkos::LayoutLeft>>("restart     left ", n, trials);
+  run_test<checkpoint_restart<Kokkos::LayoutRight>>("restart     right", n, trials);
+
+  stats::section("Memory usage");
   run_test<capacity<SoA>>("capacity SoA ", n, trials);
   run_test<capacity<AoS>>("capacity AoS ", n, trials);
 
   Kokkos::finalize();
-}
 
+  if (!trace_path.empty() && !trace::write(trace_path)) {
+    std::cerr << "Cannot write trace " << trace_path << std::endl;
+    return 1;
+  }
+  if (!save_path.empty() && !stats::current().save(save_path)) {
+    std::cerr << "Cannot write baseline " << save_path << std::endl;
+    return 1;
+  }
+  if (!baseline_path.empty()) {
+    std::cout << "Comparison with " << baseline_path << std::endl;
+    if (stats::compare(baseline, stats::current(), threshold) > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
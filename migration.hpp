@@ -0,0 +1,305 @@
+
+// Particle migration between ranks
+// The unit cube is split into slabs along x, one per rank, with periodic
+// boundaries. After each Euler step the particles that left a rank's slab are
+// packed into a send buffer per neighbour, exchanged, and unpacked into the
+// dead slots of the receiving rank
+// Buffers always hold AoS particle_t records, so packing is a single record
+// copy per particle for LayoutRight but a gather of 13 fields for the SoA
+// layouts, and unpacking the matching scatter
+// particle_migration runs every rank in this process and exchanges by handing
+// over the send buffers, as ranks sharing memory would; mpi/migration.cpp runs
+// one rank per MPI process
+
+#ifndef MIGRATION_HPP
+#define MIGRATION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <vector>
+
+#include "euler_particle.hpp"
+#include "particle_interaction.hpp"
+
+namespace migration {
+
+typedef euler_particles<Kokkos::LayoutRight>::particle_t packed_type;
+
+// neighbour directions
+constexpr int left = 0;
+constexpr int right = 1;
+
+// time step of the euler_particles step kernels
+constexpr double dt = 0.001;
+// fastest particles cross this fraction of a slab per step
+constexpr double max_crossing = 0.02;
+
+// Copies particle i into a buffer entry, field by field
+template<class Access>
+KOKKOS_INLINE_FUNCTION void pack(const Access& p, const size_t i, packed_type& out) {
+  out.x_accel = p.x_accel(i);
+  out.y_accel = p.y_accel(i);
+  out.z_accel = p.z_accel(i);
+  out.x_vel = p.x_vel(i);
+  out.y_vel = p.y_vel(i);
+  out.z_vel = p.z_vel(i);
+  out.x = p.x(i);
+  out.y = p.y(i);
+  out.z = p.z(i);
+  out.lifetime = p.lifetime(i);
+  out.x_resistance = p.x_resistance(i);
+  out.y_resistance = p.y_resistance(i);
+  out.z_resistance = p.z_resistance(i);
+}
+
+// The AoS particles already are buffer entries
+KOKKOS_INLINE_FUNCTION void pack(const euler_access<euler_particles<Kokkos::LayoutRight>>& p, const size_t i, packed_type& out) {
+  out = p.particles(i);
+}
+
+template<class Access>
+KOKKOS_INLINE_FUNCTION void unpack(const Access& p, const size_t i, const packed_type& in) {
+  p.x_accel(i) = in.x_accel;
+  p.y_accel(i) = in.y_accel;
+  p.z_accel(i) = in.z_accel;
+  p.x_vel(i) = in.x_vel;
+  p.y_vel(i) = in.y_vel;
+  p.z_vel(i) = in.z_vel;
+  p.x(i) = in.x;
+  p.y(i) = in.y;
+  p.z(i) = in.z;
+  p.lifetime(i) = in.lifetime;
+  p.x_resistance(i) = in.x_resistance;
+  p.y_resistance(i) = in.y_resistance;
+  p.z_resistance(i) = in.z_resistance;
+}
+
+KOKKOS_INLINE_FUNCTION void unpack(const euler_access<euler_particles<Kokkos::LayoutRight>>& p, const size_t i, const packed_type& in) {
+  p.particles(i) = in;
+}
+
+// The particles of one rank
+// Slots are twice the initial number of particles so there is room for
+// arrivals, and free slots are dead particles (lifetime 0)
+template<class Particles>
+struct domain {
+  const size_t capacity;
+  // owned range of x
+  const double lo;
+  const double hi;
+
+  Particles state;
+
+  // indices of the particles leaving in each direction, and their records
+  Kokkos::View<uint32_t*> leaving[2];
+  Kokkos::View<packed_type*> send[2];
+  size_t send_count[2] = {0, 0};
+
+  // records arriving from each direction, set by the exchange
+  Kokkos::View<packed_type*> recv[2];
+  size_t recv_count[2] = {0, 0};
+
+  Kokkos::View<uint32_t*> free;
+  size_t available = 0;
+  // arrivals that did not fit, which should stay 0
+  size_t dropped = 0;
+
+  domain(size_t n, int index, int ranks)
+    : capacity(2*n), lo(double(index)/ranks), hi(double(index + 1)/ranks),
+      state(capacity),
+      leaving{Kokkos::View<uint32_t*>("migration::leaving_left", capacity),
+              Kokkos::View<uint32_t*>("migration::leaving_right", capacity)},
+      send{Kokkos::View<packed_type*>("migration::send_left", capacity),
+           Kokkos::View<packed_type*>("migration::send_right", capacity)},
+      free("migration::free", capacity) {
+    setup(n, index);
+  }
+
+  // n live particles spread over the slab with x velocities up to
+  // max_crossing of the slab per step, and constant velocity otherwise
+  void setup(const size_t n, const int index) {
+    const euler_access<Particles> p(state);
+    const double lo = this->lo;
+    const double width = hi - lo;
+    const double max_vel = max_crossing*width/dt;
+
+    Kokkos::parallel_for("migration::setup", capacity, KOKKOS_LAMBDA(const size_t& i) {
+      const uint64_t id = uint64_t(index)*n + i;
+      p.x_accel(i) = 0;
+      p.y_accel(i) = 0;
+      p.z_accel(i) = 0;
+      p.x_vel(i) = (2*interaction::uniform(id, 0) - 1)*max_vel;
+      p.y_vel(i) = 0;
+      p.z_vel(i) = 0;
+      p.x(i) = lo + interaction::uniform(id, 1)*width;
+      p.y(i) = interaction::uniform(id, 2);
+      p.z(i) = interaction::uniform(id, 3);
+      p.lifetime(i) = i < n ? 1u << 31 : 0;
+      p.x_resistance(i) = 0;
+      p.y_resistance(i) = 0;
+      p.z_resistance(i) = 0;
+    });
+    Kokkos::fence();
+  }
+
+  void step() {
+    state.step(capacity);
+  }
+
+  // finds the live particles outside the slab
+  void select() {
+    const euler_access<Particles> p(state);
+    const double lo = this->lo;
+    const double hi = this->hi;
+
+    for (int direction : {left, right}) {
+      auto leaving = this->leaving[direction];
+      uint32_t count = 0;
+      Kokkos::parallel_scan("migration::select", capacity, KOKKOS_LAMBDA(const size_t& i, uint32_t& offset, const bool final) {
+        const bool leaves = p.lifetime(i) > 0 && (direction == left ? p.x(i) < lo : p.x(i) >= hi);
+        if (final && leaves) {
+          leaving(offset) = i;
+        }
+        offset += leaves;
+      }, count);
+      send_count[direction] = count;
+    }
+  }
+
+  // copies the leaving particles into the send buffers and frees their slots
+  void pack() {
+    const euler_access<Particles> p(state);
+
+    for (int direction : {left, right}) {
+      auto leaving = this->leaving[direction];
+      auto send = this->send[direction];
+      Kokkos::parallel_for("migration::pack", send_count[direction], KOKKOS_LAMBDA(const size_t& j) {
+        const uint32_t i = leaving(j);
+        migration::pack(p, i, send(j));
+        p.lifetime(i) = 0;
+      });
+    }
+  }
+
+  // lists the free slots, including those of the packed particles
+  void find_free() {
+    const euler_access<Particles> p(state);
+    auto free = this->free;
+
+    uint32_t count = 0;
+    Kokkos::parallel_scan("migration::free", capacity, KOKKOS_LAMBDA(const size_t& i, uint32_t& offset, const bool final) {
+      const bool is_dead = p.lifetime(i) == 0;
+      if (final && is_dead) {
+        free(offset) = i;
+      }
+      offset += is_dead;
+    }, count);
+    available = count;
+  }
+
+  // copies the received particles into free slots, wrapping x into [0, 1)
+  void unpack() {
+    const euler_access<Particles> p(state);
+    auto free = this->free;
+
+    size_t first = 0;
+    for (int direction : {left, right}) {
+      auto recv = this->recv[direction];
+      const size_t count = std::min(recv_count[direction], available - first);
+      dropped += recv_count[direction] - count;
+      Kokkos::parallel_for("migration::unpack", count, KOKKOS_LAMBDA(const size_t& j) {
+        const uint32_t i = free(first + j);
+        migration::unpack(p, i, recv(j));
+        p.x(i) -= std::floor(p.x(i));
+      });
+      first += count;
+    }
+  }
+};
+
+} // namespace migration
+
+// Euler step and migration between ranks slabs, with every rank in this
+// process and the exchange handing each send buffer to the neighbour
+// Each trial is one step of every rank
+template<class Particles>
+struct particle_migration {
+  const size_t n;
+  const int ranks;
+
+  std::vector<migration::domain<Particles>> domains;
+
+  std::vector<uint64_t> times;
+  uint64_t pack_time = 0;
+  uint64_t unpack_time = 0;
+  uint64_t migrated = 0;
+
+  // n particles split over ranks
+  particle_migration(size_t n, int ranks) : n(n), ranks(ranks) {
+    domains.reserve(ranks);
+    for (int r = 0; r < ranks; r++) {
+      domains.emplace_back(n/ranks, r, ranks);
+    }
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (auto& d : domains) {
+      d.step();
+      d.select();
+    }
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    for (auto& d : domains) {
+      d.pack();
+    }
+    Kokkos::fence();
+    auto t3 = std::chrono::high_resolution_clock::now();
+    for (auto& d : domains) {
+      d.find_free();
+    }
+
+    for (int r = 0; r < ranks; r++) {
+      auto& d = domains[r];
+      const auto& from_left = domains[(r + ranks - 1) % ranks];
+      const auto& from_right = domains[(r + 1) % ranks];
+      d.recv[migration::left] = from_left.send[migration::right];
+      d.recv_count[migration::left] = from_left.send_count[migration::right];
+      d.recv[migration::right] = from_right.send[migration::left];
+      d.recv_count[migration::right] = from_right.send_count[migration::left];
+      migrated += d.recv_count[migration::left] + d.recv_count[migration::right];
+    }
+
+    auto t4 = std::chrono::high_resolution_clock::now();
+    for (auto& d : domains) {
+      d.unpack();
+    }
+    Kokkos::fence();
+    auto t5 = std::chrono::high_resolution_clock::now();
+
+    pack_time += std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count();
+    unpack_time += std::chrono::duration_cast<std::chrono::nanoseconds>(t5 - t4).count();
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t5 - t1).count());
+  }
+
+  void report() const {
+    size_t dropped = 0;
+    for (const auto& d : domains) {
+      dropped += d.dropped;
+    }
+    const double bytes = double(migrated)*sizeof(migration::packed_type);
+    std::cout << "    Migrated: " << migrated/times.size() << " per step; "
+              << "Pack: " << bytes/pack_time << " (GB/s); "
+              << "Unpack: " << bytes/unpack_time << " (GB/s)";
+    if (dropped) {
+      std::cout << "; Dropped: " << dropped;
+    }
+    std::cout << std::endl;
+  }
+};
+
+#endif // MIGRATION_HPP
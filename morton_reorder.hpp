@@ -0,0 +1,261 @@
+
+// Morton order particle reordering
+// Particles are sorted by the Morton (Z-order) key of their position in the
+// unit cube, so particles that are close in space are close in memory
+// Reordering is one gather of whole records for the AoS layout but one gather
+// per field for the SoA layouts
+
+#ifndef MORTON_REORDER_HPP
+#define MORTON_REORDER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <utility>
+#include <vector>
+
+#include "euler_particle.hpp"
+#include "particle_interaction.hpp"
+
+namespace morton {
+
+// spreads the low 10 bits of v so there are two zero bits between each
+KOKKOS_INLINE_FUNCTION uint32_t spread_bits(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v <<  8)) & 0x0300f00f;
+  v = (v | (v <<  4)) & 0x030c30c3;
+  v = (v | (v <<  2)) & 0x09249249;
+  return v;
+}
+
+// Morton key of a position in the unit cube, with bits resolution per axis
+KOKKOS_INLINE_FUNCTION uint32_t key(const double x, const double y, const double z, const int bits) {
+  const double scale = double(1u << bits);
+  const uint32_t top = (1u << bits) - 1;
+  // clamped before converting, which is undefined for values out of range
+  const double sx = x*scale;
+  const double sy = y*scale;
+  const double sz = z*scale;
+  const uint32_t cx = !(sx > 0) ? 0 : sx >= top ? top : uint32_t(sx);
+  const uint32_t cy = !(sy > 0) ? 0 : sy >= top ? top : uint32_t(sy);
+  const uint32_t cz = !(sz > 0) ? 0 : sz >= top ? top : uint32_t(sz);
+  return spread_bits(cx) | (spread_bits(cy) << 1) | (spread_bits(cz) << 2);
+}
+
+// bits per axis so there are about as many keys as interaction cells
+inline int key_bits(size_t n) {
+  const double cells_per_axis = std::cbrt(n/interaction::particles_per_cell);
+  return std::min(10, std::max(1, int(std::ceil(std::log2(std::max(1.0, cells_per_axis))))));
+}
+
+// Sort state shared by every layout
+struct sorter {
+  const size_t n;
+  const int bits;
+
+  Kokkos::View<uint32_t*> keys;
+  Kokkos::View<uint32_t*> count;
+  Kokkos::View<size_t*>   start;
+  Kokkos::View<uint32_t*> order;
+
+  sorter(size_t n)
+    : n(n), bits(key_bits(n)),
+      keys("morton::keys", n),
+      count("morton::count", size_t(1) << (3*bits)),
+      start("morton::start", (size_t(1) << (3*bits)) + 1),
+      order("morton::order", n) {
+  }
+
+  void sort() {
+    interaction::counting_sort(keys, count, start, order);
+  }
+};
+
+// Reorders a particle set into Morton order, using a second particle set of
+// the same size as the destination and then swapping the two
+template<class Particles>
+struct reorder {
+};
+
+template<>
+struct reorder<euler_particles<Kokkos::LayoutRight>> {
+  sorter sort;
+  euler_particles<Kokkos::LayoutRight> scratch;
+
+  reorder(size_t n) : sort(n), scratch(n) {}
+
+  void operator()(euler_particles<Kokkos::LayoutRight>& p) {
+    auto particles = p.particles;
+    auto permuted = scratch.particles;
+    auto keys = sort.keys;
+    auto order = sort.order;
+    const int bits = sort.bits;
+
+    Kokkos::parallel_for("morton::keys", p.n, KOKKOS_LAMBDA(const size_t& i) {
+      keys(i) = key(particles(i).x, particles(i).y, particles(i).z, bits);
+    });
+    sort.sort();
+
+    // one gather of whole particles
+    Kokkos::parallel_for("morton::permute", p.n, KOKKOS_LAMBDA(const size_t& i) {
+      permuted(i) = particles(order(i));
+    });
+    Kokkos::fence();
+
+    std::swap(p.particles, scratch.particles);
+  }
+};
+
+template<>
+struct reorder<euler_particles<Kokkos::LayoutLeft>> {
+  sorter sort;
+  euler_particles<Kokkos::LayoutLeft> scratch;
+
+  reorder(size_t n) : sort(n), scratch(n) {}
+
+  template<class View>
+  void permute(View& field, View& permuted) {
+    auto order = sort.order;
+    auto src = field;
+    auto dst = permuted;
+    Kokkos::parallel_for("morton::permute", field.extent(0), KOKKOS_LAMBDA(const size_t& i) {
+      dst(i) = src(order(i));
+    });
+    std::swap(field, permuted);
+  }
+
+  void operator()(euler_particles<Kokkos::LayoutLeft>& p) {
+    auto x = p.x;
+    auto y = p.y;
+    auto z = p.z;
+    auto keys = sort.keys;
+    const int bits = sort.bits;
+
+    Kokkos::parallel_for("morton::keys", p.n, KOKKOS_LAMBDA(const size_t& i) {
+      keys(i) = key(x(i), y(i), z(i), bits);
+    });
+    sort.sort();
+
+    // one gather per field
+    permute(p.x_accel, scratch.x_accel);
+    permute(p.y_accel, scratch.y_accel);
+    permute(p.z_accel, scratch.z_accel);
+    permute(p.x_vel, scratch.x_vel);
+    permute(p.y_vel, scratch.y_vel);
+    permute(p.z_vel, scratch.z_vel);
+    permute(p.x, scratch.x);
+    permute(p.y, scratch.y);
+    permute(p.z, scratch.z);
+    permute(p.lifetime, scratch.lifetime);
+    permute(p.x_resistance, scratch.x_resistance);
+    permute(p.y_resistance, scratch.y_resistance);
+    permute(p.z_resistance, scratch.z_resistance);
+    Kokkos::fence();
+  }
+};
+
+template<class Layout>
+struct reorder<euler_particles_vos<Layout>> {
+  typedef euler_particles_vos<Layout> particles_type;
+
+  sorter sort;
+  particles_type scratch;
+
+  reorder(size_t n) : sort(n), scratch(n) {}
+
+  void operator()(particles_type& p) {
+    typedef typename particles_type::x x;
+    typedef typename particles_type::y y;
+    typedef typename particles_type::z z;
+
+    auto particles = p.particles;
+    auto permuted = scratch.particles;
+    auto keys = sort.keys;
+    auto order = sort.order;
+    const int bits = sort.bits;
+
+    Kokkos::parallel_for("morton_vos::keys", p.n, KOKKOS_LAMBDA(const size_t& i) {
+      keys(i) = key(particles(i, x()), particles(i, y()), particles(i, z()), bits);
+    });
+    sort.sort();
+
+    // a single loop gathering every field
+    Kokkos::parallel_for("morton_vos::permute", p.n, KOKKOS_LAMBDA(const size_t& i) {
+      const size_t j = order(i);
+      permuted(i, typename particles_type::x_accel()) = particles(j, typename particles_type::x_accel());
+      permuted(i, typename particles_type::y_accel()) = particles(j, typename particles_type::y_accel());
+      permuted(i, typename particles_type::z_accel()) = particles(j, typename particles_type::z_accel());
+      permuted(i, typename particles_type::x_vel()) = particles(j, typename particles_type::x_vel());
+      permuted(i, typename particles_type::y_vel()) = particles(j, typename particles_type::y_vel());
+      permuted(i, typename particles_type::z_vel()) = particles(j, typename particles_type::z_vel());
+      permuted(i, x()) = particles(j, x());
+      permuted(i, y()) = particles(j, y());
+      permuted(i, z()) = particles(j, z());
+      permuted(i, typename particles_type::lifetime()) = particles(j, typename particles_type::lifetime());
+      permuted(i, typename particles_type::x_resistance()) = particles(j, typename particles_type::x_resistance());
+      permuted(i, typename particles_type::y_resistance()) = particles(j, typename particles_type::y_resistance());
+      permuted(i, typename particles_type::z_resistance()) = particles(j, typename particles_type::z_resistance());
+    });
+    Kokkos::fence();
+
+    std::swap(p.particles, scratch.particles);
+  }
+};
+
+} // namespace morton
+
+// Interaction then Euler step, reordering into Morton order every interval
+// steps (never if interval is 0)
+// Each trial is one step, including the reorder when one happens
+template<class Interaction>
+struct morton_interaction {
+  typedef typename Interaction::particles_type particles_type;
+
+  const size_t n;
+  const size_t interval;
+
+  Interaction inner;
+  morton::reorder<particles_type> reorder;
+
+  std::vector<uint64_t> times;
+  uint64_t reorder_time = 0;
+  size_t reorders = 0;
+  size_t steps = 0;
+
+  morton_interaction(size_t n, size_t interval)
+    : n(n), interval(interval), inner(n), reorder(n) {
+  }
+
+  void test() {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (interval != 0 && steps % interval == 0) {
+      reorder(inner.state);
+      reorders++;
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    inner.test();
+    inner.state.step(n);
+    Kokkos::fence();
+    auto t3 = std::chrono::high_resolution_clock::now();
+
+    steps++;
+    reorder_time += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t1).count());
+  }
+
+  void report() const {
+    uint64_t total = 0;
+    for (uint64_t time : times) {
+      total += time;
+    }
+    std::cout << "    Reorders: " << reorders << "; "
+              << "Reorder: " << (reorders ? reorder_time/1e6/reorders : 0.0) << " (ms); "
+              << "Step without reorder: " << (total - reorder_time)/1e6/times.size() << " (ms)" << std::endl;
+  }
+};
+
+#endif // MORTON_REORDER_HPP
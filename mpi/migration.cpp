@@ -0,0 +1,120 @@
+/*
+ * Particle migration with one rank per MPI process
+ * Build with make migration.mpi and run with e.g. mpirun -np 4 ./migration.mpi 1000000 10
+ */
+
+#include<Kokkos_Core.hpp>
+#include<mpi.h>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+
+#include "migration.hpp"
+
+// Sends the leaving particles to the neighbouring ranks and receives theirs
+template<class Domain>
+void exchange(Domain& d, const int left_rank, const int right_rank) {
+  for (int direction : {migration::left, migration::right}) {
+    const int to = direction == migration::left ? left_rank : right_rank;
+    const int from = direction == migration::left ? right_rank : left_rank;
+    // what is sent left arrives from the right
+    const int arriving = 1 - direction;
+
+    unsigned long long send_count = d.send_count[direction];
+    unsigned long long recv_count = 0;
+    MPI_Sendrecv(&send_count, 1, MPI_UNSIGNED_LONG_LONG, to, 0,
+                 &recv_count, 1, MPI_UNSIGNED_LONG_LONG, from, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(d.send[direction].data(), int(send_count*sizeof(migration::packed_type)), MPI_BYTE, to, 1,
+                 d.recv[arriving].data(), int(recv_count*sizeof(migration::packed_type)), MPI_BYTE, from, 1,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    d.recv_count[arriving] = recv_count;
+  }
+}
+
+// Runs the migration steps for one particle layout and prints the times of
+// the slowest rank
+template<class Particles>
+void run_migration(const char* name, const size_t n, const size_t trials, const int rank, const int ranks) {
+  migration::domain<Particles> d(n, rank, ranks);
+  for (int direction : {migration::left, migration::right}) {
+    d.recv[direction] = Kokkos::View<migration::packed_type*>("migration::recv", d.capacity);
+  }
+  const int left_rank = (rank + ranks - 1) % ranks;
+  const int right_rank = (rank + 1) % ranks;
+
+  // pack, exchange (with finding free slots) and unpack times in ns, then
+  // particles received
+  double local[4] = {0, 0, 0, 0};
+  for (size_t t = 0; t < trials; t++) {
+    d.step();
+    d.select();
+    Kokkos::fence();
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    d.pack();
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    exchange(d, left_rank, right_rank);
+    d.find_free();
+    Kokkos::fence();
+    auto t3 = std::chrono::high_resolution_clock::now();
+    d.unpack();
+    Kokkos::fence();
+    auto t4 = std::chrono::high_resolution_clock::now();
+
+    local[0] += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    local[1] += std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count();
+    local[2] += std::chrono::duration_cast<std::chrono::nanoseconds>(t4 - t3).count();
+    local[3] += d.recv_count[migration::left] + d.recv_count[migration::right];
+  }
+
+  double slowest[3];
+  double migrated;
+  MPI_Reduce(local, slowest, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&local[3], &migrated, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    // bytes packed and unpacked by an average rank
+    const double bytes = migrated/ranks*sizeof(migration::packed_type);
+    std::cout << name << "  Migrated: " << migrated/trials << " per step; "
+              << "Pack: " << bytes/slowest[0] << " (GB/s); "
+              << "Exchange: " << slowest[1]/1e6/trials << " (ms); "
+              << "Unpack: " << bytes/slowest[2] << " (GB/s)" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  int rank, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  if (argc < 3) {
+    if (rank == 0) {
+      printf("Arguments: N tests\n");
+      printf("  N:   Number of particles per rank\n");
+      printf("  tests: number of steps of each layout\n");
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+  Kokkos::initialize();
+
+  const size_t n = atoi(argv[1]);
+  const size_t trials = atoi(argv[2]);
+
+  if (rank == 0) {
+    std::cout << "Particle migration over " << ranks << " ranks" << std::endl;
+  }
+  run_migration<euler_particles<Kokkos::LayoutLeft>>("migrate     left ", n, trials, rank, ranks);
+  run_migration<euler_particles<Kokkos::LayoutRight>>("migrate     right", n, trials, rank, ranks);
+  run_migration<euler_particles_vos<Kokkos::LayoutLeft>>("migrate sov left ", n, trials, rank, ranks);
+  run_migration<euler_particles_vos<Kokkos::LayoutRight>>("migrate sov right", n, trials, rank, ranks);
+
+  Kokkos::finalize();
+  MPI_Finalize();
+  return 0;
+}
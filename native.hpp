@@ -0,0 +1,294 @@
+
+// The copy, mixed copy and Euler kernels without Kokkos
+// Each kernel is written once over raw buffers and run by one of two engines:
+//  * par_unseq: std::for_each(std::execution::par_unseq, ...)
+//  * openmp: a #pragma omp parallel for simd loop
+// so comparing them with the Kokkos tests separates the cost of Kokkos from
+// the cost of the layout
+// Buffers are allocated without initialising them, so their pages are first
+// touched by the setup kernel of the same engine, as Kokkos Views are by its
+// initialisation kernels
+// The parallel algorithms are only available at C++17, where the standard
+// library provides them (libstdc++ runs them on TBB), and the OpenMP engine
+// is only run in builds with OpenMP, since otherwise its loop is serial.
+// Tests of an engine that is not built are listed as such
+
+#ifndef NATIVE_HPP
+#define NATIVE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+#if __has_include(<execution>)
+#include <execution>
+#endif
+
+#include "copy.hpp"
+#include "copy_mixed.hpp"
+#include "euler_particle.hpp"
+#include "record.hpp"
+
+#if defined(__cpp_lib_parallel_algorithm) && !defined(KOKKOS_ENABLE_CUDA)
+#define NATIVE_PAR_UNSEQ
+#endif
+
+namespace native {
+
+// why the par_unseq engine is not in this build
+#if defined(KOKKOS_ENABLE_CUDA)
+constexpr const char* par_unseq_missing = "not in CUDA builds";
+#else
+constexpr const char* par_unseq_missing = "needs the C++17 parallel algorithms (KOKKOS_CXX_STANDARD=c++17)";
+#endif
+
+struct par_unseq {};
+struct openmp {};
+
+#ifdef NATIVE_PAR_UNSEQ
+// Calls f(i) for each i below n, where range is any array of n entries
+// The parallel algorithms iterate over elements rather than indices, so the
+// index is recovered from the address of the element in range
+template<class T, class F>
+void for_each(par_unseq, T* range, const size_t n, const F& f) {
+  std::for_each(std::execution::par_unseq, range, range + n, [=](const T& entry) {
+    f(size_t(&entry - range));
+  });
+}
+#endif
+
+template<class T, class F>
+void for_each(openmp, T*, const size_t n, const F& f) {
+#pragma omp parallel for simd
+  for (size_t i = 0; i < n; i++) {
+    f(i);
+  }
+}
+
+// Raw storage of n records, with the field<I>(i) interface of record.hpp
+// LayoutRight is an array of plain structs and LayoutLeft an array per field
+template<class Struct, class Layout>
+struct buffers {
+};
+
+template<class... Ts>
+struct buffers<Kokkos::Struct<Ts...>, Kokkos::LayoutRight> : records::traits<Kokkos::Struct<Ts...>> {
+  typedef records::record<Ts...> value_type;
+
+  // what kernels capture: a pointer, copied into each
+  struct access {
+    value_type* data;
+
+    template<size_t I>
+    typename records::traits<Kokkos::Struct<Ts...>>::template field_type<I>& field(const size_t i) const {
+      return records::get<I>(data[i]);
+    }
+
+    value_type* range() const {
+      return data;
+    }
+  };
+
+  std::unique_ptr<value_type[]> data;
+
+  buffers(size_t n) : data(new value_type[n]) {
+  }
+
+  access pointers() const {
+    return access{data.get()};
+  }
+};
+
+template<class... Ts>
+struct buffers<Kokkos::Struct<Ts...>, Kokkos::LayoutLeft> : records::traits<Kokkos::Struct<Ts...>> {
+  struct access {
+    std::tuple<Ts*...> data;
+
+    template<size_t I>
+    typename records::traits<Kokkos::Struct<Ts...>>::template field_type<I>& field(const size_t i) const {
+      return std::get<I>(data)[i];
+    }
+
+    typename std::tuple_element<0, std::tuple<Ts...>>::type* range() const {
+      return std::get<0>(data);
+    }
+  };
+
+  std::tuple<std::unique_ptr<Ts[]>...> data;
+
+  buffers(size_t n) : data(std::unique_ptr<Ts[]>(new Ts[n])...) {
+  }
+
+  access pointers() const {
+    return pointers(std::index_sequence_for<Ts...>());
+  }
+
+  template<size_t... I>
+  access pointers(std::index_sequence<I...>) const {
+    return access{std::make_tuple(std::get<I>(data).get()...)};
+  }
+};
+
+// Names the fields of Euler particle records for euler_integrate
+template<class Access>
+struct euler_fields {
+  Access p;
+
+  double& x_accel(const size_t i) const { return p.template field<0>(i); }
+  double& y_accel(const size_t i) const { return p.template field<1>(i); }
+  double& z_accel(const size_t i) const { return p.template field<2>(i); }
+  double& x_vel(const size_t i) const { return p.template field<3>(i); }
+  double& y_vel(const size_t i) const { return p.template field<4>(i); }
+  double& z_vel(const size_t i) const { return p.template field<5>(i); }
+  double& x(const size_t i) const { return p.template field<6>(i); }
+  double& y(const size_t i) const { return p.template field<7>(i); }
+  double& z(const size_t i) const { return p.template field<8>(i); }
+  uint32_t& lifetime(const size_t i) const { return p.template field<9>(i); }
+  uint8_t& x_resistance(const size_t i) const { return p.template field<10>(i); }
+  uint8_t& y_resistance(const size_t i) const { return p.template field<11>(i); }
+  uint8_t& z_resistance(const size_t i) const { return p.template field<12>(i); }
+};
+
+} // namespace native
+
+// Copies every field of src to dst, as record_copy
+template<class Engine, class Struct, class Layout>
+struct native_record_copy {
+  typedef native::buffers<Struct, Layout> storage;
+
+  const size_t n;
+
+  // fields per entry, and the size of each
+  static constexpr int fields = storage::fields;
+  static constexpr size_t field_size(const int field) { return storage::field_size(field); }
+
+  // read from src and written to dst, and no arithmetic
+  const size_t bytes;
+  static constexpr size_t flops = 0;
+
+  storage src;
+  storage dst;
+
+  std::vector<uint64_t> times;
+
+  native_record_copy(size_t n) : n(n), bytes(2*n*storage::entry_size()), src(n), dst(n) {
+    setup();
+  }
+
+  void setup() {
+    const auto src = this->src.pointers();
+    const auto dst = this->dst.pointers();
+    const size_t n = this->n;
+    native::for_each(Engine(), src.range(), n, [=](const size_t i) {
+      records::for_each_field(typename storage::indices(), [&](auto field) {
+        src.template field<decltype(field)::value>(i) = n;
+        dst.template field<decltype(field)::value>(i) = 0;
+      });
+    });
+  }
+
+  void test() {
+    const auto src = this->src.pointers();
+    const auto dst = this->dst.pointers();
+
+    // time copy kernel
+    auto t1 = std::chrono::high_resolution_clock::now();
+    native::for_each(Engine(), dst.range(), n, [=](const size_t i) {
+      records::for_each_field(typename storage::indices(), [&](auto field) {
+        dst.template field<decltype(field)::value>(i) = src.template field<decltype(field)::value>(i);
+      });
+    });
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // reset for next iteration
+    reset();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void reset() {
+    const auto dst = this->dst.pointers();
+    native::for_each(Engine(), dst.range(), n, [=](const size_t i) {
+      records::for_each_field(typename storage::indices(), [&](auto field) {
+        dst.template field<decltype(field)::value>(i) = 0;
+      });
+    });
+  }
+};
+
+template<class Engine, class Layout>
+using native_copy = native_record_copy<Engine, copy_struct_type, Layout>;
+
+template<class Engine, class Layout>
+using native_mixed = native_record_copy<Engine, copy_mixed_type, Layout>;
+
+// The Euler step of euler_particles
+template<class Engine, class Layout>
+struct native_euler {
+  typedef native::buffers<euler_particle_struct, Layout> storage;
+
+  const size_t n;
+
+  storage particles;
+
+  // work of a step, from the particles alive at setup
+  size_t bytes = 0;
+  size_t flops = 0;
+
+  std::vector<uint64_t> times;
+
+  native_euler(size_t n) : n(n), particles(n) {
+    setup();
+    count_work();
+  }
+
+  void count_work() {
+    const native::euler_fields<typename storage::access> p{particles.pointers()};
+    size_t live = 0;
+    for (size_t i = 0; i < n; i++) {
+      live += p.lifetime(i) > 0;
+    }
+    bytes = live*euler_live_bytes + (n - live)*euler_dead_bytes;
+    flops = live*euler_live_flops;
+  }
+
+  void setup() {
+    const native::euler_fields<typename storage::access> p{particles.pointers()};
+    const size_t n = this->n;
+    native::for_each(Engine(), p.p.range(), n, [=](const size_t i) {
+      p.x_accel(i) = 5*i;
+      p.y_accel(i) = 2.4*i - 10000;
+      p.z_accel(i) = 0.87*(i*i);
+
+      p.x_vel(i) = 1.0/i;
+      p.y_vel(i) = -2.0/i;
+      p.z_vel(i) = 1.0/(n-i);
+
+      p.x(i) = -1.5/(i*i);
+      p.y(i) = 2.0/(n-i*i);
+      p.z(i) = 1.0/(i*i);
+
+      p.lifetime(i) = ((i*31)%1024) * 100;
+
+      p.x_resistance(i) = (i*71) < 10;
+      p.y_resistance(i) = (i*91) < 10;
+      p.z_resistance(i) = (i*81) < 10;
+    });
+  }
+
+  void test() {
+    const native::euler_fields<typename storage::access> p{particles.pointers()};
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    native::for_each(Engine(), p.p.range(), n, [=](const size_t i) {
+      euler_integrate(p, i);
+    });
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+};
+
+#endif // NATIVE_HPP
@@ -0,0 +1,385 @@
+
+// Short-range particle interactions
+// Particles are binned into a uniform grid of cells no narrower than the
+// cutoff, then each particle gathers the positions of every particle in its
+// own and the 26 neighbouring cells and sums a soft repulsive force, which is
+// stored as its acceleration
+// Unlike the Euler step, most of the traffic is gathers of other particles
+
+#ifndef PARTICLE_INTERACTION_HPP
+#define PARTICLE_INTERACTION_HPP
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <vector>
+
+#include "euler_particle.hpp"
+
+namespace interaction {
+
+// average particles per cell, which sets the cutoff
+constexpr double particles_per_cell = 8;
+constexpr double stiffness = 1.0;
+
+// uniform [0, 1) value from a particle index and a stream id
+KOKKOS_INLINE_FUNCTION double uniform(uint64_t i, uint64_t stream) {
+  // splitmix64 finalizer
+  uint64_t z = i*0x9E3779B97F4A7C15ull + stream*0xD1B54A32D192ED03ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z = z ^ (z >> 31);
+  return (z >> 11) * (1.0/9007199254740992.0);
+}
+
+// Counting sort that fills order with the indices of keys grouped by
+// key, and start(k) with the first entry of key k (start has a trailing total)
+// count is scratch space with one entry per key
+inline void counting_sort(const Kokkos::View<uint32_t*>& keys, const Kokkos::View<uint32_t*>& count,
+                          const Kokkos::View<size_t*>& start, const Kokkos::View<uint32_t*>& order) {
+  const size_t n = keys.extent(0);
+  const size_t buckets = count.extent(0);
+
+  Kokkos::deep_copy(count, uint32_t(0));
+  Kokkos::parallel_for("counting_sort::count", n, KOKKOS_LAMBDA(const size_t& i) {
+    Kokkos::atomic_fetch_add(&count(keys(i)), uint32_t(1));
+  });
+
+  Kokkos::parallel_scan("counting_sort::offsets", buckets,
+    KOKKOS_LAMBDA(const size_t& k, size_t& offset, const bool final) {
+    if (final) {
+      start(k) = offset;
+    }
+    offset += count(k);
+    if (final && k == buckets - 1) {
+      start(buckets) = offset;
+    }
+  });
+
+  Kokkos::deep_copy(count, uint32_t(0));
+  Kokkos::parallel_for("counting_sort::fill", n, KOKKOS_LAMBDA(const size_t& i) {
+    const uint32_t k = keys(i);
+    order(start(k) + Kokkos::atomic_fetch_add(&count(k), uint32_t(1))) = i;
+  });
+  Kokkos::fence();
+}
+
+// Uniform grid over the unit cube, with particles counting sorted by cell
+struct cell_grid {
+  const size_t n;
+  const int dim;
+  const double cutoff;
+
+  Kokkos::View<uint32_t*> cell;   // cell of each particle
+  Kokkos::View<uint32_t*> count;  // particles in each cell
+  Kokkos::View<size_t*>   start;  // first entry of each cell in order, plus the total
+  Kokkos::View<uint32_t*> order;  // particle indices grouped by cell
+
+  cell_grid(size_t n)
+    : n(n),
+      dim(std::max(1, int(std::cbrt(n/particles_per_cell)))),
+      cutoff(1.0/dim),
+      cell("cell_grid::cell", n),
+      count("cell_grid::count", size_t(dim)*dim*dim),
+      start("cell_grid::start", size_t(dim)*dim*dim + 1),
+      order("cell_grid::order", n) {
+  }
+
+  // clamped before converting, which is undefined for values out of range
+  KOKKOS_INLINE_FUNCTION int coord(double x) const {
+    const double c = x*dim;
+    return !(c > 0) ? 0 : (c >= dim - 1 ? dim - 1 : int(c));
+  }
+
+  KOKKOS_INLINE_FUNCTION uint32_t index(int cx, int cy, int cz) const {
+    return (uint32_t(cz)*dim + cy)*dim + cx;
+  }
+
+  // groups particles by the contents of cell
+  void sort() {
+    counting_sort(cell, count, start, order);
+  }
+};
+
+// Force on a particle from a neighbour at offset (dx, dy, dz)
+// Returns whether the neighbour is within the cutoff
+KOKKOS_INLINE_FUNCTION bool pair_force(const double dx, const double dy, const double dz,
+                                       const double cutoff,
+                                       double& fx, double& fy, double& fz) {
+  const double r2 = dx*dx + dy*dy + dz*dz;
+  if (r2 >= cutoff*cutoff || r2 == 0) {
+    return false;
+  }
+  const double r = std::sqrt(r2);
+  const double s = stiffness*(cutoff - r)/r;
+  fx -= s*dx;
+  fy -= s*dy;
+  fz -= s*dz;
+  return true;
+}
+
+// Calls f(j) for each particle j in the cells neighbouring (cx, cy, cz)
+template<class F>
+KOKKOS_INLINE_FUNCTION void for_each_neighbour(const cell_grid& grid, const int cx, const int cy, const int cz, const F& f) {
+  for (int z = cz - 1; z <= cz + 1; z++) {
+    if (z < 0 || z >= grid.dim) continue;
+    for (int y = cy - 1; y <= cy + 1; y++) {
+      if (y < 0 || y >= grid.dim) continue;
+      for (int x = cx - 1; x <= cx + 1; x++) {
+        if (x < 0 || x >= grid.dim) continue;
+        const uint32_t c = grid.index(x, y, z);
+        for (size_t k = grid.start(c); k < grid.start(c + 1); k++) {
+          f(grid.order(k));
+        }
+      }
+    }
+  }
+}
+
+inline void print_rate(const uint64_t interactions, const std::vector<uint64_t>& times) {
+  uint64_t total = 0;
+  for (uint64_t time : times) {
+    total += time;
+  }
+  std::cout << "    Interactions: " << interactions/times.size() << " per step; "
+            << interactions/(total*1e-9) << " (interactions/s)" << std::endl;
+}
+
+} // namespace interaction
+
+template<class Layout>
+struct particle_interaction {
+};
+
+template<>
+struct particle_interaction<Kokkos::LayoutRight> {
+
+  typedef euler_particles<Kokkos::LayoutRight> particles_type;
+
+  const size_t n;
+
+  particles_type state;
+  interaction::cell_grid grid;
+
+  std::vector<uint64_t> times;
+  uint64_t interactions = 0;
+
+  particle_interaction(size_t n) : n(n), state(n), grid(n) {
+    setup();
+  }
+
+  // scatter the particles uniformly over the unit cube, with velocities
+  // uniform in [-1, 1) so they stay finite as they move
+  void setup() {
+    auto particles = state.particles;
+    Kokkos::parallel_for("particle_interaction::setup", n, KOKKOS_LAMBDA(const size_t& i) {
+      particles(i).x = interaction::uniform(i, 0);
+      particles(i).y = interaction::uniform(i, 1);
+      particles(i).z = interaction::uniform(i, 2);
+      particles(i).x_vel = 2*interaction::uniform(i, 3) - 1;
+      particles(i).y_vel = 2*interaction::uniform(i, 4) - 1;
+      particles(i).z_vel = 2*interaction::uniform(i, 5) - 1;
+    });
+    Kokkos::fence();
+  }
+
+  void test() {
+    auto particles = state.particles;
+    const interaction::cell_grid grid = this->grid;
+    size_t count = 0;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_for("particle_interaction::bin", n, KOKKOS_LAMBDA(const size_t& i) {
+      grid.cell(i) = grid.index(grid.coord(particles(i).x), grid.coord(particles(i).y), grid.coord(particles(i).z));
+    });
+    this->grid.sort();
+
+    Kokkos::parallel_reduce("particle_interaction::test", n, KOKKOS_LAMBDA(const size_t& i, size_t& local) {
+      const double x = particles(i).x;
+      const double y = particles(i).y;
+      const double z = particles(i).z;
+      double fx = 0, fy = 0, fz = 0;
+
+      interaction::for_each_neighbour(grid, grid.coord(x), grid.coord(y), grid.coord(z), [&](const uint32_t j) {
+        local += interaction::pair_force(particles(j).x - x, particles(j).y - y, particles(j).z - z,
+                                         grid.cutoff, fx, fy, fz);
+      });
+
+      particles(i).x_accel = fx;
+      particles(i).y_accel = fy;
+      particles(i).z_accel = fz;
+    }, count);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    interactions += count;
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    interaction::print_rate(interactions, times);
+  }
+};
+
+template<>
+struct particle_interaction<Kokkos::LayoutLeft> {
+
+  typedef euler_particles<Kokkos::LayoutLeft> particles_type;
+
+  const size_t n;
+
+  particles_type state;
+  interaction::cell_grid grid;
+
+  std::vector<uint64_t> times;
+  uint64_t interactions = 0;
+
+  particle_interaction(size_t n) : n(n), state(n), grid(n) {
+    setup();
+  }
+
+  // scatter the particles uniformly over the unit cube, with velocities
+  // uniform in [-1, 1) so they stay finite as they move
+  void setup() {
+    auto x = state.x;
+    auto y = state.y;
+    auto z = state.z;
+    auto x_vel = state.x_vel;
+    auto y_vel = state.y_vel;
+    auto z_vel = state.z_vel;
+    Kokkos::parallel_for("particle_interaction::setup", n, KOKKOS_LAMBDA(const size_t& i) {
+      x(i) = interaction::uniform(i, 0);
+      y(i) = interaction::uniform(i, 1);
+      z(i) = interaction::uniform(i, 2);
+      x_vel(i) = 2*interaction::uniform(i, 3) - 1;
+      y_vel(i) = 2*interaction::uniform(i, 4) - 1;
+      z_vel(i) = 2*interaction::uniform(i, 5) - 1;
+    });
+    Kokkos::fence();
+  }
+
+  void test() {
+    auto x = state.x;
+    auto y = state.y;
+    auto z = state.z;
+    auto x_accel = state.x_accel;
+    auto y_accel = state.y_accel;
+    auto z_accel = state.z_accel;
+    const interaction::cell_grid grid = this->grid;
+    size_t count = 0;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_for("particle_interaction::bin", n, KOKKOS_LAMBDA(const size_t& i) {
+      grid.cell(i) = grid.index(grid.coord(x(i)), grid.coord(y(i)), grid.coord(z(i)));
+    });
+    this->grid.sort();
+
+    Kokkos::parallel_reduce("particle_interaction::test", n, KOKKOS_LAMBDA(const size_t& i, size_t& local) {
+      const double xi = x(i);
+      const double yi = y(i);
+      const double zi = z(i);
+      double fx = 0, fy = 0, fz = 0;
+
+      interaction::for_each_neighbour(grid, grid.coord(xi), grid.coord(yi), grid.coord(zi), [&](const uint32_t j) {
+        local += interaction::pair_force(x(j) - xi, y(j) - yi, z(j) - zi, grid.cutoff, fx, fy, fz);
+      });
+
+      x_accel(i) = fx;
+      y_accel(i) = fy;
+      z_accel(i) = fz;
+    }, count);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    interactions += count;
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    interaction::print_rate(interactions, times);
+  }
+};
+
+// Interaction test implemented using the ViewOfStructs type
+template<class Layout>
+struct particle_interaction_vos {
+
+  typedef euler_particles_vos<Layout> particles_type;
+
+  const size_t n;
+
+  particles_type state;
+  interaction::cell_grid grid;
+
+  std::vector<uint64_t> times;
+  uint64_t interactions = 0;
+
+  particle_interaction_vos(size_t n) : n(n), state(n), grid(n) {
+    setup();
+  }
+
+  // scatter the particles uniformly over the unit cube, with velocities
+  // uniform in [-1, 1) so they stay finite as they move
+  void setup() {
+    auto particles = state.particles;
+    Kokkos::parallel_for("particle_interaction_vos::setup", n, KOKKOS_LAMBDA(const size_t& i) {
+      particles(i, typename particles_type::x()) = interaction::uniform(i, 0);
+      particles(i, typename particles_type::y()) = interaction::uniform(i, 1);
+      particles(i, typename particles_type::z()) = interaction::uniform(i, 2);
+      particles(i, typename particles_type::x_vel()) = 2*interaction::uniform(i, 3) - 1;
+      particles(i, typename particles_type::y_vel()) = 2*interaction::uniform(i, 4) - 1;
+      particles(i, typename particles_type::z_vel()) = 2*interaction::uniform(i, 5) - 1;
+    });
+    Kokkos::fence();
+  }
+
+  void test() {
+    typedef typename particles_type::x x;
+    typedef typename particles_type::y y;
+    typedef typename particles_type::z z;
+    typedef typename particles_type::x_accel x_accel;
+    typedef typename particles_type::y_accel y_accel;
+    typedef typename particles_type::z_accel z_accel;
+
+    auto particles = state.particles;
+    const interaction::cell_grid grid = this->grid;
+    size_t count = 0;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_for("particle_interaction_vos::bin", n, KOKKOS_LAMBDA(const size_t& i) {
+      grid.cell(i) = grid.index(grid.coord(particles(i, x())),
+                                grid.coord(particles(i, y())),
+                                grid.coord(particles(i, z())));
+    });
+    this->grid.sort();
+
+    Kokkos::parallel_reduce("particle_interaction_vos::test", n, KOKKOS_LAMBDA(const size_t& i, size_t& local) {
+      const double xi = particles(i, x());
+      const double yi = particles(i, y());
+      const double zi = particles(i, z());
+      double fx = 0, fy = 0, fz = 0;
+
+      interaction::for_each_neighbour(grid, grid.coord(xi), grid.coord(yi), grid.coord(zi), [&](const uint32_t j) {
+        local += interaction::pair_force(particles(j, x()) - xi, particles(j, y()) - yi, particles(j, z()) - zi,
+                                         grid.cutoff, fx, fy, fz);
+      });
+
+      particles(i, x_accel()) = fx;
+      particles(i, y_accel()) = fy;
+      particles(i, z_accel()) = fz;
+    }, count);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    interactions += count;
+    times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+  }
+
+  void report() const {
+    interaction::print_rate(interactions, times);
+  }
+};
+
+#endif // PARTICLE_INTERACTION_HPP
@@ -0,0 +1,204 @@
+
+// Generic record storage
+// Given the field types of a record as a Kokkos::Struct type list, provides
+// array of structs, struct of arrays and ViewOfStructs storage with the same
+// interface: field<I>(i) is a reference to field I of entry i
+// The array of structs and struct of arrays storage take Kokkos::MemoryTraits
+// flags (e.g. Kokkos::Restrict | Kokkos::Aligned) for their Views
+
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <cstdint>
+#include <Kokkos_Core.hpp>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace records {
+
+// View with the given Kokkos::MemoryTraits flags, which is a plain View when
+// there are none so code without traits keeps its existing types
+template<unsigned Traits, class DataType, class... Properties>
+using view = typename std::conditional<Traits == 0,
+                                       Kokkos::View<DataType, Properties...>,
+                                       Kokkos::View<DataType, Properties..., Kokkos::MemoryTraits<Traits>>>::type;
+
+// Calls f(std::integral_constant<size_t, I>()) for each I in order
+template<class F, size_t... I>
+KOKKOS_INLINE_FUNCTION void for_each_field(std::index_sequence<I...>, const F& f) {
+  const int expand[] = {0, (f(std::integral_constant<size_t, I>()), 0)...};
+  (void) expand;
+}
+
+// One field of a record
+// A record inherits one of these per field, which gives the same layout as a
+// plain struct with the fields declared in order
+template<size_t I, class T>
+struct record_field {
+  T value;
+};
+
+template<size_t I, class T>
+KOKKOS_INLINE_FUNCTION T& get(record_field<I, T>& field) {
+  return field.value;
+}
+
+template<size_t I, class T>
+KOKKOS_INLINE_FUNCTION const T& get(const record_field<I, T>& field) {
+  return field.value;
+}
+
+template<class Indices, class... Ts>
+struct record_impl {
+};
+
+template<size_t... I, class... Ts>
+struct record_impl<std::index_sequence<I...>, Ts...> : record_field<I, Ts>... {
+};
+
+// Plain struct with fields of types Ts
+template<class... Ts>
+struct record : record_impl<std::index_sequence_for<Ts...>, Ts...> {
+};
+
+// One field of a struct of arrays
+template<size_t I, class T, unsigned Traits>
+struct array_field {
+  view<Traits, T*> values;
+
+  array_field(const std::string& label, size_t n)
+    : values(label + "::field" + std::to_string(I), n) {
+  }
+};
+
+template<size_t I, class T, unsigned Traits>
+KOKKOS_INLINE_FUNCTION const view<Traits, T*>& get(const array_field<I, T, Traits>& field) {
+  return field.values;
+}
+
+template<class Indices, unsigned Traits, class... Ts>
+struct arrays_impl {
+};
+
+template<size_t... I, unsigned Traits, class... Ts>
+struct arrays_impl<std::index_sequence<I...>, Traits, Ts...> : array_field<I, Ts, Traits>... {
+  arrays_impl(const std::string& label, size_t n) : array_field<I, Ts, Traits>(label, n)... {
+  }
+};
+
+// A View per field
+template<unsigned Traits, class... Ts>
+struct arrays : arrays_impl<std::index_sequence_for<Ts...>, Traits, Ts...> {
+  arrays(const std::string& label, size_t n)
+    : arrays_impl<std::index_sequence_for<Ts...>, Traits, Ts...>(label, n) {
+  }
+};
+
+// Properties of a Kokkos::Struct type list shared by every storage
+template<class Struct>
+struct traits {
+};
+
+template<class... Ts>
+struct traits<Kokkos::Struct<Ts...>> {
+  static constexpr int fields = sizeof...(Ts);
+
+  typedef std::index_sequence_for<Ts...> indices;
+
+  template<size_t I>
+  using field_type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+  static constexpr size_t field_size(const int field) {
+    const size_t sizes[] = {sizeof(Ts)...};
+    return sizes[field];
+  }
+
+  // bytes of the fields of one entry, without padding
+  static constexpr size_t entry_size() {
+    const size_t sizes[] = {sizeof(Ts)...};
+    size_t total = 0;
+    for (size_t size : sizes) {
+      total += size;
+    }
+    return total;
+  }
+};
+
+} // namespace records
+
+// Storage with the layout of a Kokkos View of structs: LayoutRight is an array
+// of plain structs and LayoutLeft is a View per field
+template<class Struct, class Layout, unsigned Traits = 0>
+struct record_view {
+};
+
+template<class... Ts, unsigned Traits>
+struct record_view<Kokkos::Struct<Ts...>, Kokkos::LayoutRight, Traits> : records::traits<Kokkos::Struct<Ts...>> {
+  typedef records::record<Ts...> value_type;
+
+  records::view<Traits, value_type*, Kokkos::LayoutRight> data;
+
+  record_view(const std::string& label, size_t n) : data(label, n) {
+  }
+
+  template<size_t I>
+  KOKKOS_INLINE_FUNCTION typename records::traits<Kokkos::Struct<Ts...>>::template field_type<I>& field(const size_t i) const {
+    return records::get<I>(data(i));
+  }
+
+  void zero() {
+    Kokkos::deep_copy(data, value_type());
+  }
+};
+
+template<class... Ts, unsigned Traits>
+struct record_view<Kokkos::Struct<Ts...>, Kokkos::LayoutLeft, Traits> : records::traits<Kokkos::Struct<Ts...>> {
+  records::arrays<Traits, Ts...> data;
+
+  record_view(const std::string& label, size_t n) : data(label, n) {
+  }
+
+  template<size_t I>
+  KOKKOS_INLINE_FUNCTION typename records::traits<Kokkos::Struct<Ts...>>::template field_type<I>& field(const size_t i) const {
+    return records::get<I>(data)(i);
+  }
+
+  void zero() {
+    records::for_each_field(std::index_sequence_for<Ts...>(), [&](auto field) {
+      typedef typename records::traits<Kokkos::Struct<Ts...>>::template field_type<decltype(field)::value> T;
+      Kokkos::deep_copy(records::get<decltype(field)::value>(data), T(0));
+    });
+  }
+};
+
+// Storage using the ViewOfStructs type
+template<class Struct, class Layout>
+struct record_vos {
+};
+
+template<class... Ts, class Layout>
+struct record_vos<Kokkos::Struct<Ts...>, Layout> : records::traits<Kokkos::Struct<Ts...>> {
+  Kokkos::ViewOfStructs<Kokkos::Struct<Ts...>*, Layout> data;
+  const size_t n;
+
+  record_vos(const std::string& label, size_t n) : data(label, n), n(n) {
+  }
+
+  template<size_t I>
+  KOKKOS_INLINE_FUNCTION typename records::traits<Kokkos::Struct<Ts...>>::template field_type<I>& field(const size_t i) const {
+    return data(i, Kokkos::Field<I>());
+  }
+
+  void zero() {
+    auto data = this->data;
+    Kokkos::parallel_for("record_vos::zero", n, KOKKOS_LAMBDA(const size_t& i) {
+      records::for_each_field(std::index_sequence_for<Ts...>(), [&](auto field) {
+        data(i, Kokkos::Field<decltype(field)::value>()) = 0;
+      });
+    });
+  }
+};
+
+#endif // RECORD_HPP
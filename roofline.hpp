@@ -0,0 +1,267 @@
+
+// Roofline characterisation
+// Measures the bandwidth of a triad kernel with working sets sized for L2,
+// L3 and main memory, and the peak double precision flop rate of independent
+// vector multiply-add chains, which is compared with the theoretical peak of
+// the instruction set the host code is compiled for. Tests declaring the
+// flops and bytes of one trial are
+// then placed on the roofline: their bound is whichever of compute or the
+// bandwidth of the level their bytes fit in takes longer, and they report
+// the fraction of that bound they attain
+
+#ifndef ROOFLINE_HPP
+#define ROOFLINE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+namespace roofline {
+
+// Doubles in a vector register, and double precision flops per cycle of a
+// core with two vector FMA pipes (AVX and SSE2 have a multiply and an add
+// pipe instead), for the instruction set the host code is compiled for
+#if defined(__AVX512F__)
+constexpr const char* isa = "AVX-512";
+constexpr int simd_doubles = 8;
+constexpr double core_flops_per_cycle = 2*2*8;
+#elif defined(__AVX2__) && defined(__FMA__)
+constexpr const char* isa = "AVX2";
+constexpr int simd_doubles = 4;
+constexpr double core_flops_per_cycle = 2*2*4;
+#elif defined(__AVX__)
+constexpr const char* isa = "AVX";
+constexpr int simd_doubles = 4;
+constexpr double core_flops_per_cycle = 2*4;
+#elif defined(__SSE2__)
+constexpr const char* isa = "SSE2";
+constexpr int simd_doubles = 2;
+constexpr double core_flops_per_cycle = 2*2;
+#elif defined(__ARM_NEON)
+constexpr const char* isa = "NEON";
+constexpr int simd_doubles = 2;
+constexpr double core_flops_per_cycle = 2*2*2;
+#else
+constexpr const char* isa = nullptr;
+constexpr int simd_doubles = 1;
+constexpr double core_flops_per_cycle = 0;
+#endif
+
+struct level {
+  const char* name;
+  // bytes in the working set
+  size_t size;
+  // GB/s
+  double bandwidth;
+};
+
+struct peaks {
+  bool calibrated = false;
+  level levels[3];
+  // GFLOP/s, and the theoretical peak or 0 if it is not known
+  double flops;
+  double theoretical_flops = 0;
+  // results of the flop kernel, kept so it is not optimised away
+  double checksum = 0;
+};
+
+inline peaks& measured() {
+  static peaks p;
+  return p;
+}
+
+// size in bytes of a cache, or fallback if the system does not report it
+inline size_t cache_size(const int name, const size_t fallback) {
+  const long size = sysconf(name);
+  return size > 0 ? size : fallback;
+}
+
+// Best bandwidth in GB/s of a(i) = b(i) + s*c(i) over a working set of about
+// the given number of bytes
+inline double triad_bandwidth(const size_t bytes) {
+  // each measurement moves at least this many bytes, so launches do not dominate
+  constexpr size_t min_bytes = size_t(1) << 30;
+
+  const size_t n = std::max(bytes/(3*sizeof(double)), size_t(1024));
+  const size_t repeats = std::max(min_bytes/(3*sizeof(double)*n), size_t(1));
+  Kokkos::View<double*> a("roofline::a", n);
+  Kokkos::View<double*> b("roofline::b", n);
+  Kokkos::View<double*> c("roofline::c", n);
+  Kokkos::deep_copy(b, 1.0);
+  Kokkos::deep_copy(c, 2.0);
+  Kokkos::fence();
+
+  double best = 0;
+  for (int round = 0; round < 5; round++) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < repeats; r++) {
+      Kokkos::parallel_for("roofline::triad", n, KOKKOS_LAMBDA(const size_t& i) {
+        a(i) = b(i) + 3.0*c(i);
+      });
+    }
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    best = std::max(best, 3*sizeof(double)*n*repeats/ns);
+  }
+  return best;
+}
+
+// Best rate in GFLOP/s of multiply-add chains over a vector of consecutive
+// values per index. Each index keeps ten independent vector accumulators,
+// more than the four cycle FMA latency times two pipes of current cores, and
+// few enough to stay in the 16 vector registers of AVX2. The lanes are
+// vectorized by #pragma omp simd, which host builds enable with -fopenmp-simd
+// when they do not use OpenMP
+inline double peak_flops() {
+  constexpr int lanes = simd_doubles;
+  constexpr size_t n = (size_t(1) << 16)/lanes;
+  constexpr int chains = 10;
+  constexpr int iterations = 4096;
+
+  double best = 0;
+  for (int round = 0; round < 3; round++) {
+    double sum = 0;
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_reduce("roofline::flops", n, KOKKOS_LAMBDA(const size_t& i, double& total) {
+      double a[chains][lanes];
+      for (int j = 0; j < chains; j++) {
+        for (int l = 0; l < lanes; l++) {
+          a[j][l] = (i*lanes + l)*1e-9 + j;
+        }
+      }
+      for (int k = 0; k < iterations; k++) {
+        for (int j = 0; j < chains; j++) {
+          #pragma omp simd
+          for (int l = 0; l < lanes; l++) {
+            a[j][l] = a[j][l]*0.999999 + 1e-6;
+          }
+        }
+      }
+      for (int j = 0; j < chains; j++) {
+        for (int l = 0; l < lanes; l++) {
+          total += a[j][l];
+        }
+      }
+    }, sum);
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    const double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    measured().checksum += sum;
+    best = std::max(best, 2.0*chains*lanes*iterations*n/ns);
+  }
+  return best;
+}
+
+// Maximum clock of the host in GHz, or 0 if the system does not report it
+inline double clock_ghz() {
+  std::ifstream max_freq("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
+  double khz = 0;
+  if (max_freq >> khz && khz > 0) {
+    return khz/1e6;
+  }
+  // the current clock, without cpufreq
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 7, "cpu MHz") == 0 && line.find(':') != std::string::npos) {
+      return std::stod(line.substr(line.find(':') + 1))/1e3;
+    }
+  }
+  return 0;
+}
+
+// Physical cores of the host, counting hyperthreads of a core once, or 0 if
+// the system does not report them
+inline size_t physical_cores() {
+  std::set<std::pair<long, long>> cores;
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (long cpu = 0; cpu < cpus; cpu++) {
+    const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+    std::ifstream package(topology + "physical_package_id");
+    std::ifstream core(topology + "core_id");
+    long package_id, core_id;
+    if (package >> package_id && core >> core_id) {
+      cores.emplace(package_id, core_id);
+    }
+  }
+  return cores.size();
+}
+
+// Theoretical double precision peak in GFLOP/s of the cores the host threads
+// run on, at the maximum clock, or 0 if it is not known or the flop kernel
+// runs on a device
+inline double theoretical_flops(const size_t threads) {
+#ifdef KOKKOS_ENABLE_CUDA
+  (void) threads;
+  return 0;
+#else
+  const size_t cores = std::min(threads, physical_cores());
+  return cores*clock_ghz()*core_flops_per_cycle;
+#endif
+}
+
+// Measures and prints the peaks
+inline void calibrate() {
+  const size_t threads = std::max(int(Kokkos::DefaultExecutionSpace().concurrency()), 1);
+  const size_t l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, size_t(1) << 20);
+  const size_t l3 = cache_size(_SC_LEVEL3_CACHE_SIZE, size_t(32) << 20);
+
+  // a quarter of each thread's L2, so hyperthreads sharing one still fit,
+  // half the L3, and well past the L3
+  peaks& p = measured();
+  p.levels[0] = {"L2", threads*l2/4, 0};
+  p.levels[1] = {"L3", std::max(l3/2, p.levels[0].size*2), 0};
+  p.levels[2] = {"DRAM", std::max(16*l3, size_t(256) << 20), 0};
+
+  std::cout << "Roofline peaks" << std::endl;
+  for (level& l : p.levels) {
+    l.bandwidth = triad_bandwidth(l.size);
+    std::cout << "    " << l.name << " (" << l.size/1024.0/1024.0 << " MB): "
+              << l.bandwidth << " (GB/s)" << std::endl;
+  }
+  p.flops = peak_flops();
+  p.theoretical_flops = theoretical_flops(threads);
+  std::cout << "    Double: " << p.flops << " (GFLOP/s); ";
+  if (p.theoretical_flops > 0) {
+    std::cout << 100*p.flops/p.theoretical_flops << "% of the " << isa << " peak of "
+              << p.theoretical_flops << " (GFLOP/s); ";
+  }
+  std::cout << "Ridge point: " << p.flops/p.levels[2].bandwidth << " (flop/byte)" << std::endl;
+  p.calibrated = true;
+}
+
+// Prints where a test with the given flops and bytes per trial, and mean
+// time per trial in ns, lies against the measured peaks
+inline void print(const double flops, const double bytes, const double mean) {
+  const peaks& p = measured();
+
+  // the smallest level the bytes moved fit in
+  const level* memory = &p.levels[2];
+  for (const level& l : p.levels) {
+    if (bytes <= l.size) {
+      memory = &l;
+      break;
+    }
+  }
+
+  // GB/s and GFLOP/s are bytes and flops per ns
+  const double memory_time = bytes/memory->bandwidth;
+  const double compute_time = flops/p.flops;
+  const bool compute_bound = compute_time > memory_time;
+
+  std::cout << "    Intensity: " << (bytes > 0 ? flops/bytes : 0) << " (flop/byte); "
+            << "Bound: " << (compute_bound ? "compute" : memory->name) << "; "
+            << "Attained: " << 100*std::max(memory_time, compute_time)/mean << "% of bound" << std::endl;
+}
+
+} // namespace roofline
+
+#endif // ROOFLINE_HPP
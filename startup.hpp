@@ -0,0 +1,188 @@
+
+// Startup cost of the tests
+// Splits the time, page faults and resident set growth of constructing a
+// test into
+//  * initialisation: the kernels Kokkos runs to zero new Views, which is also
+//    where their pages are first touched
+//  * setup: every other kernel and deep_copy, which fill in the test data
+//  * allocation: the rest, the allocations themselves and any host work
+// Kernels are recognised through the Kokkos Tools callbacks, so kernels on
+// asynchronous backends are timed by their launch unless launches are made
+// blocking (e.g. CUDA_LAUNCH_BLOCKING=1)
+
+#ifndef STARTUP_HPP
+#define STARTUP_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <Kokkos_Core.hpp>
+#include <sys/resource.h>
+
+#include "footprint.hpp"
+
+namespace startup {
+
+struct phase {
+  uint64_t time = 0;
+  long faults = 0;
+  // change in resident set size in kB
+  long rss = 0;
+};
+
+struct profile {
+  phase allocation;
+  phase initialisation;
+  phase setup;
+};
+
+// minor and major page faults of this process so far
+inline long page_faults() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+// State of the current measurement
+struct recorder {
+  bool active = false;
+  // kernels and copies may launch others, only the outermost is counted
+  int depth = 0;
+  bool initialisation = false;
+  std::chrono::high_resolution_clock::time_point start;
+  long start_faults = 0;
+  long start_rss = 0;
+
+  std::chrono::high_resolution_clock::time_point begin;
+  long begin_faults = 0;
+  long begin_rss = 0;
+  // time spent reading the resident set size, not counted in any phase
+  uint64_t overhead = 0;
+  profile result;
+};
+
+inline recorder& current() {
+  static recorder r;
+  return r;
+}
+
+inline void begin_region(const char* name) {
+  recorder& r = current();
+  if (!r.active || r.depth++ > 0) {
+    return;
+  }
+  const char prefix[] = "Kokkos::View::initialization";
+  r.initialisation = std::strncmp(name, prefix, sizeof(prefix) - 1) == 0;
+  auto t1 = std::chrono::high_resolution_clock::now();
+  r.begin_rss = footprint::rss_kb();
+  r.begin_faults = page_faults();
+  r.begin = std::chrono::high_resolution_clock::now();
+  r.overhead += std::chrono::duration_cast<std::chrono::nanoseconds>(r.begin - t1).count();
+}
+
+inline void end_region() {
+  recorder& r = current();
+  if (!r.active || --r.depth > 0) {
+    return;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  phase& p = r.initialisation ? r.result.initialisation : r.result.setup;
+  p.time += std::chrono::duration_cast<std::chrono::nanoseconds>(end - r.begin).count();
+  p.faults += page_faults() - r.begin_faults;
+  p.rss += footprint::rss_kb() - r.begin_rss;
+  r.overhead += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - end).count();
+}
+
+inline void begin_kernel(const char* name, const uint32_t, uint64_t*) {
+  begin_region(name);
+}
+
+inline void end_kernel(const uint64_t) {
+  end_region();
+}
+
+inline void begin_copy(Kokkos::Tools::SpaceHandle, const char*, const void*,
+                       Kokkos::Tools::SpaceHandle, const char*, const void*, uint64_t) {
+  begin_region("deep_copy");
+}
+
+inline void end_copy() {
+  end_region();
+}
+
+// whether the callbacks are installed, without which construction is not split
+inline bool& installed() {
+  static bool i = false;
+  return i;
+}
+
+// Registers the callbacks, once after Kokkos::initialize, unless a tool
+// loaded through KOKKOS_TOOLS_LIBS has them, as they would replace its own
+inline void install() {
+  if (Kokkos::Profiling::profileLibraryLoaded()) {
+    return;
+  }
+  installed() = true;
+  using namespace Kokkos::Tools::Experimental;
+  set_begin_parallel_for_callback(begin_kernel);
+  set_end_parallel_for_callback(end_kernel);
+  set_begin_parallel_reduce_callback(begin_kernel);
+  set_end_parallel_reduce_callback(end_kernel);
+  set_begin_parallel_scan_callback(begin_kernel);
+  set_end_parallel_scan_callback(end_kernel);
+  set_begin_deep_copy_callback(begin_copy);
+  set_end_deep_copy_callback(end_copy);
+}
+
+// Starts measuring, just before a test is constructed
+inline void start() {
+  recorder& r = current();
+  r = recorder();
+  r.active = true;
+  r.start_rss = footprint::rss_kb();
+  r.start_faults = page_faults();
+  r.start = std::chrono::high_resolution_clock::now();
+}
+
+// Stops measuring, once the test is constructed
+inline profile stop() {
+  Kokkos::fence();
+  auto end = std::chrono::high_resolution_clock::now();
+  recorder& r = current();
+  r.active = false;
+
+  profile p = r.result;
+  const uint64_t total = std::chrono::duration_cast<std::chrono::nanoseconds>(end - r.start).count();
+  const long faults = page_faults() - r.start_faults;
+  const long rss = footprint::rss_kb() - r.start_rss;
+  p.allocation.time = total - r.overhead - p.initialisation.time - p.setup.time;
+  p.allocation.faults = faults - p.initialisation.faults - p.setup.faults;
+  p.allocation.rss = rss - p.initialisation.rss - p.setup.rss;
+  return p;
+}
+
+inline void print(const char* name, const phase& p) {
+  std::cout << name << ": " << p.time/1e6 << " (ms), " << p.faults << " faults, "
+            << (p.rss >= 0 ? "+" : "") << p.rss/1024.0 << " (MB) RSS";
+}
+
+inline void print(const profile& p) {
+  std::cout << "    Startup: ";
+  if (!installed()) {
+    // every kernel was counted as allocation
+    print("Construction", p.allocation);
+    std::cout << " (not split while a Kokkos tool is loaded)" << std::endl;
+    return;
+  }
+  print("Allocation", p.allocation);
+  std::cout << "; ";
+  print("Initialisation", p.initialisation);
+  std::cout << "; ";
+  print("Setup", p.setup);
+  std::cout << std::endl;
+}
+
+} // namespace startup
+
+#endif // STARTUP_HPP
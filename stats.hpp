@@ -0,0 +1,240 @@
+
+// Statistics of the test times and comparison against a baseline
+// Every test's mean, standard deviation and trial count is recorded, can be
+// saved as a baseline file, and compared with a saved baseline using Welch's
+// t-test, which does not assume the two runs have the same variance
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace stats {
+
+// t values for 99% confidence iterval, by degrees of freedom from 1
+constexpr double t_values_99[] = {
+    63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.49, 3.355, 3.250, 3.169,
+     3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
+     2.831, 2.819, 2.807, 2.797, 2.787, 2.779, 2.771, 2.763, 2.756, 2.750,
+     2.744, 2.738, 2.733, 2.728, 2.724, 2.719, 2.715, 2.712, 2.708, 2.704
+  };
+
+// Regularized incomplete beta function I_x(a, b), by its continued fraction
+inline double incomplete_beta(const double a, const double b, const double x) {
+  if (x <= 0) {
+    return 0;
+  }
+  if (x >= 1) {
+    return 1;
+  }
+  // the continued fraction converges quickly only below the mean
+  if (x > (a + 1)/(a + b + 2)) {
+    return 1 - incomplete_beta(b, a, 1 - x);
+  }
+
+  const double tiny = 1e-300;
+  const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+                                + a*std::log(x) + b*std::log(1 - x))/a;
+
+  // modified Lentz's method
+  double c = 1;
+  double d = 1 - (a + b)*x/(a + 1);
+  d = 1/(std::fabs(d) < tiny ? tiny : d);
+  double f = d;
+  for (int m = 1; m <= 300; m++) {
+    for (int odd = 0; odd < 2; odd++) {
+      const double numerator = odd
+        ? -(a + m)*(a + b + m)*x/((a + 2*m)*(a + 2*m + 1))
+        : m*(b - m)*x/((a + 2*m - 1)*(a + 2*m));
+      d = 1 + numerator*d;
+      d = 1/(std::fabs(d) < tiny ? tiny : d);
+      c = 1 + numerator/c;
+      c = std::fabs(c) < tiny ? tiny : c;
+      f *= c*d;
+    }
+    if (std::fabs(c*d - 1) < 1e-12) {
+      break;
+    }
+  }
+  return front*f;
+}
+
+// Probability that |T| >= t for Student's t distribution, for any positive
+// (not necessarily whole) degrees of freedom
+inline double t_two_sided(const double t, const double df) {
+  return incomplete_beta(df/2, 0.5, df/(df + t*t));
+}
+
+// t value for a 99% confidence interval with df degrees of freedom
+// The table is used where it has an entry, and the distribution is inverted
+// by bisection otherwise
+inline double t_value_99(const double df) {
+  if (df == std::floor(df) && df >= 1 && df <= 40) {
+    return t_values_99[size_t(df) - 1];
+  }
+  double lo = 0;
+  double hi = 1000;
+  for (int i = 0; i < 100; i++) {
+    const double mid = (lo + hi)/2;
+    (t_two_sided(mid, df) > 0.01 ? lo : hi) = mid;
+  }
+  return (lo + hi)/2;
+}
+
+// Summary of the times of one test, in ns
+struct sample {
+  size_t trials;
+  double mean;
+  double stdev;
+};
+
+// Welch's t-test of the difference in mean between two samples
+struct welch {
+  double t;
+  double df;
+  // two sided p value
+  double p;
+  // Cohen's d, the difference in means in units of the average standard deviation
+  double effect;
+
+  welch(const sample& a, const sample& b) {
+    const double va = a.stdev*a.stdev/a.trials;
+    const double vb = b.stdev*b.stdev/b.trials;
+    const double se = std::sqrt(va + vb);
+    const double spread = std::sqrt((a.stdev*a.stdev + b.stdev*b.stdev)/2);
+
+    t = se > 0 ? (b.mean - a.mean)/se : 0;
+    // Welch-Satterthwaite approximation
+    df = se > 0 ? (va + vb)*(va + vb)/(va*va/(a.trials - 1) + vb*vb/(b.trials - 1)) : 1;
+    // without a spread, e.g. from single trials, no change is significant
+    p = se > 0 ? t_two_sided(t, df) : 1;
+    effect = spread > 0 ? (b.mean - a.mean)/spread : 0;
+  }
+};
+
+// Results of the tests run so far, by name in the order they ran
+// Each name is the section the test ran in and its label, so a baseline
+// matches tests by what they are and not by the order they ran in. A name
+// that was already recorded is reported and not recorded again
+struct results {
+  std::vector<std::string> names;
+  std::map<std::string, sample> samples;
+  // section of the tests being run
+  std::string section;
+  size_t duplicates = 0;
+
+  void add(std::string name, const sample& s) {
+    // names are padded for alignment
+    name.erase(name.find_last_not_of(' ') + 1);
+    if (!section.empty()) {
+      name = section + ": " + name;
+    }
+    if (samples.count(name)) {
+      std::cerr << "Test " << name << " has already run; its result is not recorded" << std::endl;
+      duplicates++;
+      return;
+    }
+    names.push_back(name);
+    samples[name] = s;
+  }
+
+  // One tab separated line per test: name, trials, mean and stdev in ns
+  bool save(const std::string& path) const {
+    std::ofstream file(path);
+    file << "# name\ttrials\tmean (ns)\tstdev (ns)\n";
+    file.precision(17);
+    for (const std::string& name : names) {
+      const sample& s = samples.at(name);
+      file << name << '\t' << s.trials << '\t' << s.mean << '\t' << s.stdev << '\n';
+    }
+    return bool(file);
+  }
+
+  bool load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+      return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      std::istringstream fields(line);
+      std::string name;
+      sample s;
+      std::getline(fields, name, '\t');
+      fields >> s.trials >> s.mean >> s.stdev;
+      if (fields) {
+        names.push_back(name);
+        samples[name] = s;
+      }
+    }
+    return true;
+  }
+};
+
+// Results of this run
+inline results& current() {
+  static results r;
+  return r;
+}
+
+// Prints the title of a section and names the tests that follow after it
+inline void section(const std::string& title) {
+  std::cout << title << std::endl;
+  current().section = title;
+}
+
+// Prints the tests that changed significantly since the baseline, and
+// returns the number that became slower by more than threshold percent
+inline size_t compare(const results& baseline, const results& run, const double threshold) {
+  // significance of a change
+  const double alpha = 0.01;
+
+  size_t regressions = 0;
+  size_t improvements = 0;
+  size_t missing = 0;
+  for (const std::string& name : run.names) {
+    auto found = baseline.samples.find(name);
+    if (found == baseline.samples.end()) {
+      missing++;
+      continue;
+    }
+    const sample& before = found->second;
+    const sample& after = run.samples.at(name);
+    const welch test(before, after);
+    const double change = 100*(after.mean - before.mean)/before.mean;
+
+    if (test.p >= alpha || std::fabs(change) <= threshold) {
+      continue;
+    }
+    const bool slower = change > 0;
+    (slower ? regressions : improvements)++;
+    std::cout << (slower ? "REGRESSION  " : "improvement ") << name << "  "
+              << before.mean/1e6 << " -> " << after.mean/1e6 << " (ms); "
+              << "Change: " << change << "%; "
+              << "Effect size: " << test.effect << "; "
+              << "p: " << test.p << std::endl;
+  }
+
+  std::cout << "Compared " << run.names.size() - missing << " tests against the baseline: "
+            << regressions << " regressions, " << improvements << " improvements beyond "
+            << threshold << "% at 99% confidence";
+  if (missing) {
+    std::cout << "; " << missing << " not in the baseline";
+  }
+  std::cout << std::endl;
+  return regressions;
+}
+
+} // namespace stats
+
+#endif // STATS_HPP
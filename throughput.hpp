@@ -0,0 +1,260 @@
+
+// Throughput of concurrent instances of a test
+// Runs M copies of a test at once, each in its own process pinned to its own
+// group of cores, as when several jobs share a node, and compares their
+// bandwidth with one instance running alone on the same cores
+// Each instance is this executable started again with --instance, so it has
+// its own Kokkos and OpenMP runtime sized to its group. Instances construct
+// their test, report that they are ready, and wait on stdin until every
+// instance is ready before running their trials, so the trials overlap
+// Core groups are taken in order of socket, then core, then hardware thread,
+// so a group fills whole cores of one socket before moving to the next
+
+#ifndef THROUGHPUT_HPP
+#define THROUGHPUT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sched.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace throughput {
+
+// A test that can be run as an instance, named by its kernel and layout
+struct entry {
+  const char* test;
+  const char* layout;
+  void (*run)(size_t n, size_t trials);
+};
+
+// Mean time in ns of the trials of one instance, and the bytes of a trial
+struct result {
+  double mean;
+  double bytes;
+};
+
+// Runs a test as one instance, in the process started by launch
+template<class Test>
+void instance(const size_t n, const size_t trials) {
+  Test test(n);
+  std::cout << "ready" << std::endl;
+  char start;
+  if (read(STDIN_FILENO, &start, 1) != 1) {
+    return;
+  }
+
+  for (size_t i = 0; i < trials; i++) {
+    test.test();
+  }
+  uint64_t total = 0;
+  for (uint64_t time : test.times) {
+    total += time;
+  }
+  std::cout.precision(17);
+  std::cout << double(total)/trials << " " << double(test.bytes) << std::endl;
+}
+
+// Value of a topology file of a cpu, or fallback if it cannot be read
+inline int topology(const int cpu, const char* name, const int fallback) {
+  std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+  int value;
+  return file >> value ? value : fallback;
+}
+
+// Splits the cpus this process may run on into count equal groups, which is
+// empty if there are fewer cpus than groups
+inline std::vector<cpu_set_t> core_groups(const size_t count) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  struct cpu {
+    int package;
+    int core;
+    int id;
+  };
+  std::vector<cpu> cpus;
+  for (int id = 0; id < CPU_SETSIZE; id++) {
+    if (CPU_ISSET(id, &allowed)) {
+      cpus.push_back({topology(id, "physical_package_id", 0), topology(id, "core_id", id), id});
+    }
+  }
+  std::sort(cpus.begin(), cpus.end(), [](const cpu& a, const cpu& b) {
+    return a.package != b.package ? a.package < b.package
+         : a.core != b.core ? a.core < b.core
+         : a.id < b.id;
+  });
+
+  const size_t size = cpus.size()/count;
+  std::vector<cpu_set_t> groups;
+  for (size_t g = 0; size > 0 && g < count; g++) {
+    cpu_set_t group;
+    CPU_ZERO(&group);
+    for (size_t i = g*size; i < (g + 1)*size; i++) {
+      CPU_SET(cpus[i].id, &group);
+    }
+    groups.push_back(group);
+  }
+  return groups;
+}
+
+// Runs test index of the entries as one instance on each of the groups at
+// once, returning their results, or none if any instance failed
+inline std::vector<result> launch(const size_t index, const std::vector<cpu_set_t>& groups,
+                                  const std::string& n, const std::string& trials) {
+  const std::string exe = "/proc/self/exe";
+  const std::string option = "--instance=" + std::to_string(index);
+  char* const argv[] = {const_cast<char*>(exe.c_str()), const_cast<char*>(option.c_str()),
+                        const_cast<char*>(n.c_str()), const_cast<char*>(trials.c_str()), nullptr};
+
+  // the environment of each instance, with as many OpenMP threads as cpus in
+  // its group, which bind within the group's affinity mask
+  std::vector<std::string> variables;
+  for (char** variable = environ; *variable; variable++) {
+    const std::string v = *variable;
+    if (v.compare(0, 16, "OMP_NUM_THREADS=") != 0 && v.compare(0, 11, "OMP_PLACES=") != 0) {
+      variables.push_back(v);
+    }
+  }
+  variables.push_back("OMP_NUM_THREADS=" + std::to_string(CPU_COUNT(&groups[0])));
+  std::vector<char*> envp;
+  for (std::string& v : variables) {
+    envp.push_back(&v[0]);
+  }
+  envp.push_back(nullptr);
+
+  int start[2];
+  if (pipe(start) != 0) {
+    return {};
+  }
+  std::vector<pid_t> pids;
+  std::vector<FILE*> outputs;
+  for (const cpu_set_t& group : groups) {
+    int output[2];
+    if (pipe(output) != 0) {
+      break;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+      dup2(start[0], STDIN_FILENO);
+      dup2(output[1], STDOUT_FILENO);
+      close(start[0]);
+      close(start[1]);
+      close(output[0]);
+      close(output[1]);
+      sched_setaffinity(0, sizeof(group), &group);
+      execve(argv[0], argv, envp.data());
+      _exit(127);
+    }
+    close(output[1]);
+    if (pid < 0) {
+      close(output[0]);
+      break;
+    }
+    pids.push_back(pid);
+    outputs.push_back(fdopen(output[0], "r"));
+  }
+  close(start[0]);
+
+  // wait until every instance is ready, then start them all
+  bool ok = pids.size() == groups.size();
+  char line[256];
+  for (FILE* output : outputs) {
+    ok = ok && fgets(line, sizeof(line), output) && std::string(line) == "ready\n";
+  }
+  if (ok) {
+    const std::string go(pids.size(), 'g');
+    ok = write(start[1], go.data(), go.size()) == ssize_t(go.size());
+  }
+  close(start[1]);
+
+  std::vector<result> results;
+  for (FILE* output : outputs) {
+    result r;
+    if (ok && fgets(line, sizeof(line), output) && sscanf(line, "%lf %lf", &r.mean, &r.bytes) == 2) {
+      results.push_back(r);
+    } else {
+      ok = false;
+    }
+    fclose(output);
+  }
+  for (pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return ok ? results : std::vector<result>();
+}
+
+// Runs every layout of the named test alone and as count concurrent
+// instances, printing their bandwidth, and returns false on failure
+inline bool run(const std::vector<entry>& entries, const std::string& test, const size_t count,
+                const std::string& n, const std::string& trials) {
+  bool found = false;
+  for (const entry& e : entries) {
+    found = found || test == e.test;
+  }
+  if (!found) {
+    std::cerr << "No test named " << test << " to run in throughput mode; choose one of";
+    for (size_t index = 0; index < entries.size(); index++) {
+      if (index == 0 || std::string(entries[index].test) != entries[index - 1].test) {
+        std::cerr << " " << entries[index].test;
+      }
+    }
+    std::cerr << std::endl;
+    return false;
+  }
+
+  const std::vector<cpu_set_t> groups = core_groups(count);
+  if (groups.empty()) {
+    std::cerr << "Fewer cpus than the " << count << " instances" << std::endl;
+    return false;
+  }
+  std::cout << "Throughput of " << count << " instances of " << test << " on "
+            << CPU_COUNT(&groups[0]) << " cpus each" << std::endl;
+
+  for (size_t index = 0; index < entries.size(); index++) {
+    if (test != entries[index].test) {
+      continue;
+    }
+
+    // alone on the cores of the first instance
+    const std::vector<result> alone = launch(index, {groups[0]}, n, trials);
+    const std::vector<result> shared = launch(index, groups, n, trials);
+    std::cout << test << " " << entries[index].layout << "  ";
+    if (alone.empty() || shared.empty()) {
+      std::cout << "failed" << std::endl;
+      return false;
+    }
+
+    // bytes per ns is GB/s
+    double aggregate = 0;
+    double mean = 0;
+    for (const result& r : shared) {
+      aggregate += r.bytes/r.mean;
+      mean += r.mean/shared.size();
+    }
+    std::cout << "Alone: " << alone[0].bytes/alone[0].mean << " (GB/s); "
+              << "Aggregate: " << aggregate << " (GB/s); "
+              << "Slowdown: " << mean/alone[0].mean << std::endl;
+    std::cout << "    Per instance:";
+    for (const result& r : shared) {
+      std::cout << " " << r.bytes/r.mean;
+    }
+    std::cout << " (GB/s)" << std::endl;
+  }
+
+  return true;
+}
+
+} // namespace throughput
+
+#endif // THROUGHPUT_HPP
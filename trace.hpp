@@ -0,0 +1,189 @@
+
+// Timeline of a benchmark session as Chrome trace JSON
+// Records a begin and an end event, with the time and the thread, for every
+// kernel, deep copy and fence Kokkos reports through its Tools callbacks, and
+// for the construction and each trial of every test, so resets and setups
+// appear inside the test they belong to. The file can be opened in
+// chrome://tracing or ui.perfetto.dev
+// Each host thread that issues work gets its own track. Work on asynchronous
+// backends shows where it was launched, and the fences show where the host
+// waited for it
+// Kokkos has one callback per event type, so the kernel and copy callbacks
+// here replace those of startup.hpp and call them as well
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <Kokkos_Core.hpp>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "startup.hpp"
+
+namespace trace {
+
+struct event {
+  std::string name;
+  const char* category;
+  // 'B' for begin or 'E' for end
+  char phase;
+  // ns since the trace started
+  uint64_t time;
+  uint32_t thread;
+  // trial number, or -1
+  long trial;
+};
+
+struct recorder {
+  bool enabled = false;
+  std::chrono::steady_clock::time_point start;
+  std::mutex mutex;
+  std::vector<event> events;
+  // track of each thread, in the order they first recorded an event
+  std::map<std::thread::id, uint32_t> threads;
+};
+
+inline recorder& current() {
+  static recorder r;
+  return r;
+}
+
+inline void record(const char* name, const char* category, const char phase, const long trial) {
+  recorder& r = current();
+  if (!r.enabled) {
+    return;
+  }
+  const uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - r.start).count();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  const uint32_t thread = r.threads.emplace(std::this_thread::get_id(), r.threads.size()).first->second;
+  r.events.push_back({name, category, phase, time, thread, trial});
+}
+
+inline void begin(const char* name, const char* category, const long trial = -1) {
+  record(name, category, 'B', trial);
+}
+
+inline void end(const char* category) {
+  record("", category, 'E', -1);
+}
+
+// Kokkos Tools callbacks, with the trace events outside the startup ones so
+// recording is not counted in the startup cost
+
+inline void begin_kernel(const char* name, const uint32_t device, uint64_t* id) {
+  begin(name, "kernel");
+  startup::begin_kernel(name, device, id);
+}
+
+inline void end_kernel(const uint64_t id) {
+  startup::end_kernel(id);
+  end("kernel");
+}
+
+inline void begin_copy(Kokkos::Tools::SpaceHandle dst_space, const char* dst_name, const void* dst,
+                       Kokkos::Tools::SpaceHandle src_space, const char* src_name, const void* src,
+                       uint64_t size) {
+  const std::string name = std::string("deep_copy ") + src_name + " -> " + dst_name;
+  begin(name.c_str(), "copy");
+  startup::begin_copy(dst_space, dst_name, dst, src_space, src_name, src, size);
+}
+
+inline void end_copy() {
+  startup::end_copy();
+  end("copy");
+}
+
+inline void begin_fence(const char* name, const uint32_t, uint64_t*) {
+  begin(name, "fence");
+}
+
+inline void end_fence(const uint64_t) {
+  end("fence");
+}
+
+// Registers the callbacks, once after startup::install, returning false
+// without them if a tool loaded through KOKKOS_TOOLS_LIBS has them
+inline bool install() {
+  if (Kokkos::Profiling::profileLibraryLoaded()) {
+    return false;
+  }
+  using namespace Kokkos::Tools::Experimental;
+  set_begin_parallel_for_callback(begin_kernel);
+  set_end_parallel_for_callback(end_kernel);
+  set_begin_parallel_reduce_callback(begin_kernel);
+  set_end_parallel_reduce_callback(end_kernel);
+  set_begin_parallel_scan_callback(begin_kernel);
+  set_end_parallel_scan_callback(end_kernel);
+  set_begin_deep_copy_callback(begin_copy);
+  set_end_deep_copy_callback(end_copy);
+  set_begin_fence_callback(begin_fence);
+  set_end_fence_callback(end_fence);
+  return true;
+}
+
+// Starts recording
+inline void start() {
+  recorder& r = current();
+  r.start = std::chrono::steady_clock::now();
+  r.enabled = true;
+}
+
+inline std::string escape(const std::string& text) {
+  std::string escaped;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Stops recording and writes the events to path
+inline bool write(const std::string& path) {
+  recorder& r = current();
+  r.enabled = false;
+
+  std::ofstream file(path);
+  file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": {\"name\": \"benchmark\"}}";
+  for (const auto& thread : r.threads) {
+    file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << thread.second
+         << ", \"args\": {\"name\": \"" << (thread.second == 0 ? "main" : "thread " + std::to_string(thread.second)) << "\"}}";
+  }
+
+  char time[32];
+  for (const event& e : r.events) {
+    // microseconds, to the ns
+    snprintf(time, sizeof(time), "%.3f", e.time/1000.0);
+    file << ",\n{\"ph\": \"" << e.phase << "\", \"cat\": \"" << e.category << "\", \"ts\": " << time
+         << ", \"pid\": 0, \"tid\": " << e.thread;
+    if (e.phase == 'B') {
+      file << ", \"name\": \"" << escape(e.name) << "\"";
+    }
+    if (e.trial >= 0) {
+      file << ", \"args\": {\"trial\": " << e.trial << "}";
+    }
+    file << "}";
+  }
+  file << "\n]}\n";
+  return bool(file);
+}
+
+} // namespace trace
+
+#endif // TRACE_HPP